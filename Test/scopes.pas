@@ -0,0 +1,20 @@
+begin
+  integer k;
+  integer m;
+  integer function F(n);
+    begin
+      integer n;
+      if n<=0 then F:=1
+      else F:=n*F(n-1)
+    end;
+  integer function G(n);
+    begin
+      integer n;
+      G:=n-1
+    end;
+  read(m);
+  k:=G(m);
+  write(k);
+  k:=F(m);
+  write(k)
+end
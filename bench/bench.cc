@@ -0,0 +1,216 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "diagnostics.hh"
+#include "generator.hh"
+#include "lexer.hh"
+#include "parser.hh"
+
+const std::string DATA_DIR = "bench/data";
+const std::string BASELINE_PATH = "bench/baseline.txt";
+const char* STAGES[] = {"read", "lex", "parse", "output"};
+
+static auto Seconds(const std::function<void()>& stage) -> double {
+  const auto start = std::chrono::steady_clock::now();
+  stage();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/* 生成的程序按大小缓存在 DATA_DIR 中, 生成时间不计入 */
+static auto Prepare(const std::string& size) -> std::string {
+  const auto path = DATA_DIR + "/bench-" + size + ".pas";
+  if (!std::ifstream(path)) {
+    ::mkdir(DATA_DIR.c_str(), 0755);
+    GeneratorOptions options;
+    options.size = ParseSize(size);
+    std::ofstream out(path);
+    GenerateProgram(options, out);
+  }
+  return path;
+}
+
+/* 依次计时读入、词法分析、语法分析与输出四个阶段 */
+static auto Run(const std::string& path) -> std::vector<double> {
+  std::vector<double> times;
+  std::vector<std::string> words;
+  times.push_back(Seconds([&] {
+    std::ifstream input(path);
+    words = SplitWords(input);
+  }));
+
+  Diagnostics diagnostics;
+  std::unique_ptr<Lexer> lexer;
+  times.push_back(Seconds([&] {
+    lexer = std::make_unique<Lexer>(std::move(words), diagnostics);
+  }));
+
+  std::unique_ptr<Parser> parser;
+  times.push_back(Seconds([&] {
+    parser = std::make_unique<Parser>(lexer->getTokens(), diagnostics);
+  }));
+  if (!lexer->good() || !parser->good()) {
+    std::cerr << path << ": generated program has " << diagnostics.errors()
+              << " errors" << std::endl;
+  }
+
+  times.push_back(Seconds([&] {
+    std::ofstream dyd(DATA_DIR + "/out.dyd"), dys(DATA_DIR + "/out.dys"),
+        var(DATA_DIR + "/out.var"), pro(DATA_DIR + "/out.pro"),
+        err(DATA_DIR + "/out.err");
+    lexer->formatPrint(dyd);
+    parser->formatPrint(dys, var, pro);
+    diagnostics.Emit(err, DiagnosticFormat::TEXT);
+  }));
+  return times;
+}
+
+/* 基线文件每行为: 大小 阶段 秒数 */
+static auto LoadBaseline() -> std::map<std::pair<std::string, std::string>, double> {
+  std::map<std::pair<std::string, std::string>, double> baseline;
+  std::ifstream input(BASELINE_PATH);
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream iss(line);
+    std::string size, stage;
+    double seconds;
+    if (iss >> size >> stage >> seconds) {
+      baseline[{size, stage}] = seconds;
+    }
+  }
+  return baseline;
+}
+
+static auto Usage(const char* name) -> int {
+  std::cerr << "Usage: " << name
+            << " [--update-baseline] [--tolerance=0.2] [--repeat=3] SIZE..."
+            << std::endl;
+  return 1;
+}
+
+/* 整个字符串都是非负整数时才成功 */
+static auto ParseNumber(const std::string& text, size_t& value) -> bool {
+  const auto end = text.data() + text.size();
+  const auto [next, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && next == end && !text.empty();
+}
+
+static auto ParseTolerance(const std::string& text, double& value) -> bool {
+  char* end = nullptr;
+  value = std::strtod(text.c_str(), &end);
+  return !text.empty() && end == text.c_str() + text.size() &&
+         std::isfinite(value) && value >= 0;
+}
+
+/* 用法: bench [--update-baseline] [--tolerance=0.2] [--repeat=3] SIZE...
+ * 每个阶段取多次运行中的最短时间,
+ * 任一阶段比基线慢超过 tolerance 时以非零状态退出 */
+int main(int argc, char* argv[]) {
+  bool update = false;
+  double tolerance = 0.2;
+  size_t repeat = 3;
+  std::vector<std::string> sizes;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--update-baseline") {
+      update = true;
+    } else if (arg.rfind("--tolerance=", 0) == 0) {
+      const auto value = arg.substr(std::string("--tolerance=").size());
+      if (!ParseTolerance(value, tolerance)) {
+        std::cerr << "Invalid value for --tolerance: " << value
+                  << " (expected a non-negative number)" << std::endl;
+        return Usage(argv[0]);
+      }
+    } else if (arg.rfind("--repeat=", 0) == 0) {
+      const auto value = arg.substr(std::string("--repeat=").size());
+      if (!ParseNumber(value, repeat) || repeat == 0) {
+        std::cerr << "Invalid value for --repeat: " << value
+                  << " (expected a positive integer)" << std::endl;
+        return Usage(argv[0]);
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage(argv[0]);
+    } else {
+      sizes.push_back(arg);
+    }
+  }
+  if (sizes.empty()) {
+    sizes = {"1M"};
+  }
+
+  /* 大小格式错误时提前退出, 不留下半生成的数据文件 */
+  for (const auto& size : sizes) {
+    try {
+      ParseSize(size);
+    } catch (const std::invalid_argument& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+  }
+
+  auto baseline = LoadBaseline();
+  bool regressed = false;
+  std::cout << std::setw(8) << "size" << std::setw(8) << "stage"
+            << std::setw(12) << "seconds" << std::setw(12) << "baseline"
+            << "\n";
+  for (const auto& size : sizes) {
+    const auto path = Prepare(size);
+    auto times = Run(path);
+    for (size_t run = 1; run < repeat; run++) {
+      const auto next = Run(path);
+      for (size_t i = 0; i < times.size(); i++) {
+        times[i] = std::min(times[i], next[i]);
+      }
+    }
+    for (size_t i = 0; i < times.size(); i++) {
+      const auto key = std::make_pair(size, std::string(STAGES[i]));
+      std::cout << std::setw(8) << size << std::setw(8) << STAGES[i]
+                << std::setw(12) << std::fixed << std::setprecision(4)
+                << times[i];
+      const auto it = baseline.find(key);
+      if (it == baseline.end()) {
+        std::cout << std::setw(12) << "-";
+      } else {
+        std::cout << std::setw(12) << it->second;
+        if (!update && times[i] > it->second * (1 + tolerance)) {
+          regressed = true;
+          std::cout << "  REGRESSION";
+        }
+      }
+      std::cout << "\n";
+      if (update) {
+        baseline[key] = times[i];
+      }
+    }
+  }
+
+  if (update) {
+    std::ofstream output(BASELINE_PATH);
+    output << "# size stage seconds, written by bench --update-baseline\n";
+    for (const auto& [key, seconds] : baseline) {
+      output << key.first << " " << key.second << " " << seconds << "\n";
+    }
+  }
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "generator.hh"
+
+static auto Usage(const char* name) -> int {
+  std::cerr << "Usage: " << name
+            << " [--size=1M] [--functions=N] [--function-depth=N]"
+               " [--declarations=N] [--statements=N] [--expression-length=N]"
+               " [--expression-depth=N] [--error-rate=R] [--seed=N]\n"
+               "Writes the generated program to stdout."
+            << std::endl;
+  return 1;
+}
+
+/* 整个字符串都是非负整数时才成功 */
+template <typename T>
+static auto ParseNumber(const std::string& text, T& value) -> bool {
+  const auto end = text.data() + text.size();
+  const auto [next, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && next == end && !text.empty();
+}
+
+static auto ParseRate(const std::string& text, double& value) -> bool {
+  char* end = nullptr;
+  value = std::strtod(text.c_str(), &end);
+  return !text.empty() && end == text.c_str() + text.size();
+}
+
+int main(int argc, char* argv[]) {
+  GeneratorOptions options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const auto eq = arg.find('=');
+    if (eq == std::string::npos) {
+      return Usage(argv[0]);
+    }
+    const auto key = arg.substr(0, eq);
+    const auto value = arg.substr(eq + 1);
+    bool parsed = true;
+    if (key == "--size") {
+      try {
+        options.size = ParseSize(value);
+      } catch (const std::invalid_argument&) {
+        parsed = false;
+      }
+    } else if (key == "--functions") {
+      parsed = ParseNumber(value, options.functions);
+    } else if (key == "--function-depth") {
+      parsed = ParseNumber(value, options.function_depth);
+    } else if (key == "--declarations") {
+      parsed = ParseNumber(value, options.declarations);
+    } else if (key == "--statements") {
+      parsed = ParseNumber(value, options.statements);
+    } else if (key == "--expression-length") {
+      parsed = ParseNumber(value, options.expression_length);
+    } else if (key == "--expression-depth") {
+      parsed = ParseNumber(value, options.expression_depth);
+    } else if (key == "--error-rate") {
+      parsed = ParseRate(value, options.error_rate);
+    } else if (key == "--seed") {
+      parsed = ParseNumber(value, options.seed);
+    } else {
+      return Usage(argv[0]);
+    }
+    if (!parsed) {
+      std::cerr << "Invalid value for " << key << ": " << value << std::endl;
+      return Usage(argv[0]);
+    }
+  }
+  try {
+    ValidateOptions(options);
+  } catch (const std::invalid_argument& error) {
+    std::cerr << error.what() << std::endl;
+    return Usage(argv[0]);
+  }
+  std::ios::sync_with_stdio(false);
+  GenerateProgram(options, std::cout);
+  return 0;
+}
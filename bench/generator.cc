@@ -0,0 +1,235 @@
+#include "generator.hh"
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/* splitmix64, 保证不同平台上生成结果一致 */
+class Random {
+ public:
+  Random(uint64_t seed) : _state(seed) {}
+  auto Next() -> uint64_t {
+    uint64_t z = (_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+  auto Below(size_t bound) -> size_t { return Next() % bound; }
+  auto Chance(double probability) -> bool {
+    return (Next() >> 11) * (1.0 / (1ULL << 53)) < probability;
+  }
+
+ private:
+  uint64_t _state;
+};
+
+/* 当前作用域链上可见的变量与函数 */
+struct Scope {
+  std::string function;  // 当前函数名, 主程序为空
+  std::vector<std::string> variables;
+  std::vector<std::string> procedures;
+};
+
+class Generator {
+ public:
+  Generator(const GeneratorOptions& options, std::ostream& out)
+      : _options(options), _out(out), _random(options.seed) {}
+
+  auto Run() -> size_t {
+    Scope scope;
+    Emit("begin\n");
+    Declarations(scope, 1);
+    for (size_t i = 0; i < _options.functions; i++) {
+      Function(scope, 1, _options.function_depth);
+    }
+    /* 主程序语句一直生成到达到目标大小 */
+    Statement(scope, 1);
+    while (_written < _options.size) {
+      Emit(";\n");
+      Statement(scope, 1);
+    }
+    Emit("\nend\n");
+    _out.write(_buffer.data(), _buffer.size());
+    return _written;
+  }
+
+ private:
+  const GeneratorOptions& _options;
+  std::ostream& _out;
+  Random _random;
+  std::string _buffer;
+  size_t _written = 0;
+  size_t _names = 0;
+
+  auto Emit(const std::string& text) -> void {
+    _buffer += text;
+    _written += text.size();
+    if (_buffer.size() >= (1 << 16)) {
+      _out.write(_buffer.data(), _buffer.size());
+      _buffer.clear();
+    }
+  }
+
+  auto Indent(size_t depth) -> void { Emit(std::string(depth * 2, ' ')); }
+
+  auto NewName(const char* prefix) -> std::string {
+    return prefix + std::to_string(_names++);
+  }
+
+  auto Declarations(Scope& scope, size_t depth) -> void {
+    for (size_t i = 0; i < _options.declarations; i++) {
+      const auto name = NewName("v");
+      Indent(depth);
+      Emit("integer " + name + ";\n");
+      scope.variables.push_back(name);
+    }
+  }
+
+  auto Function(Scope& scope, size_t depth, size_t nesting) -> void {
+    const auto name = NewName("f");
+    const auto parameter = NewName("p");
+    scope.procedures.push_back(name);
+
+    Scope inner = scope;
+    inner.function = name;
+    inner.variables.push_back(parameter);
+    Indent(depth);
+    Emit("integer function " + name + "(" + parameter + ");\n");
+    Indent(depth);
+    Emit("begin\n");
+    Indent(depth + 1);
+    Emit("integer " + parameter + ";\n");
+    Declarations(inner, depth + 1);
+    if (nesting > 1) {
+      Function(inner, depth + 1, nesting - 1);
+    }
+    for (size_t i = 0; i < _options.statements; i++) {
+      Statement(inner, depth + 1);
+      Emit(";\n");
+    }
+    /* 最后一条语句给函数返回值赋值 */
+    Indent(depth + 1);
+    Emit(name + ":=");
+    Expression(inner, 0);
+    Emit("\n");
+    Indent(depth);
+    Emit("end;\n");
+  }
+
+  auto Variable(const Scope& scope) -> const std::string& {
+    return scope.variables[_random.Below(scope.variables.size())];
+  }
+
+  auto Statement(const Scope& scope, size_t depth) -> void {
+    Indent(depth);
+    if (_options.error_rate > 0 && _random.Chance(_options.error_rate)) {
+      /* 缺少右括号, 语法分析器报错后可以继续 */
+      Emit("write(" + Variable(scope));
+      return;
+    }
+    switch (_random.Below(6)) {
+      case 0: {
+        Emit("read(" + Variable(scope) + ")");
+        break;
+      }
+      case 1: {
+        Emit("write(" + Variable(scope) + ")");
+        break;
+      }
+      case 2: {
+        static const char* operators[] = {"=", "<>", "<", "<=", ">", ">="};
+        Emit("if ");
+        Expression(scope, 0);
+        Emit(operators[_random.Below(6)]);
+        Expression(scope, 0);
+        Emit(" then " + Variable(scope) + ":=");
+        Expression(scope, 0);
+        Emit(" else " + Variable(scope) + ":=");
+        Expression(scope, 0);
+        break;
+      }
+      default: {
+        Emit(Variable(scope) + ":=");
+        Expression(scope, 0);
+        break;
+      }
+    }
+  }
+
+  auto Expression(const Scope& scope, size_t depth) -> void {
+    const auto terms = 1 + _random.Below(_options.expression_length);
+    for (size_t i = 0; i < terms; i++) {
+      if (i > 0) {
+        Emit(_random.Below(2) ? "-" : "*");
+      }
+      Factor(scope, depth);
+    }
+  }
+
+  auto Factor(const Scope& scope, size_t depth) -> void {
+    const auto choice = _random.Below(3);
+    if (choice == 0 && depth < _options.expression_depth &&
+        !scope.procedures.empty()) {
+      Emit(scope.procedures[_random.Below(scope.procedures.size())] + "(");
+      Expression(scope, depth + 1);
+      Emit(")");
+    } else if (choice == 1) {
+      Emit(std::to_string(_random.Below(1000)));
+    } else {
+      Emit(Variable(scope));
+    }
+  }
+};
+
+}  // namespace
+
+auto ValidateOptions(const GeneratorOptions& options) -> void {
+  if (options.declarations == 0) {
+    throw std::invalid_argument("At least one declaration is required");
+  }
+  if (options.function_depth == 0) {
+    throw std::invalid_argument("Function depth must be at least 1");
+  }
+  if (options.expression_length == 0) {
+    throw std::invalid_argument("Expression length must be at least 1");
+  }
+  /* 取反比较同时排除 NaN */
+  if (!(options.error_rate >= 0 && options.error_rate <= 1)) {
+    throw std::invalid_argument("Error rate must be between 0 and 1");
+  }
+}
+
+auto GenerateProgram(const GeneratorOptions& options, std::ostream& out)
+    -> size_t {
+  ValidateOptions(options);
+  return Generator(options, out).Run();
+}
+
+auto ParseSize(const std::string& text) -> size_t {
+  size_t size = 0;
+  const auto begin = text.data();
+  const auto end = begin + text.size();
+  const auto [next, error] = std::from_chars(begin, end, size);
+  if (error != std::errc() || next == begin) {
+    throw std::invalid_argument("Invalid size: " + text);
+  }
+  const std::string suffix(next, end);
+  size_t shift = 0;
+  if (suffix == "K" || suffix == "k") {
+    shift = 10;
+  } else if (suffix == "M" || suffix == "m") {
+    shift = 20;
+  } else if (suffix == "G" || suffix == "g") {
+    shift = 30;
+  } else if (!suffix.empty()) {
+    throw std::invalid_argument("Invalid size: " + text);
+  }
+  if (size > (SIZE_MAX >> shift)) {
+    throw std::invalid_argument("Size too large: " + text);
+  }
+  return size << shift;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/* 生成符合文法的测试程序, 相同参数总是生成相同的程序 */
+struct GeneratorOptions {
+  size_t size = 1 << 20;         // 目标字节数, 达到后停止生成主程序语句
+  size_t functions = 16;         // 主程序中的函数个数
+  size_t function_depth = 2;     // 每个函数向内嵌套的层数
+  size_t declarations = 8;       // 每个作用域的变量说明个数
+  size_t statements = 8;         // 每个函数体中的语句个数
+  size_t expression_length = 4;  // 表达式中的项数
+  size_t expression_depth = 2;   // 函数调用实参的嵌套深度
+  double error_rate = 0;         // 注入可恢复语法错误的语句比例
+  uint64_t seed = 1;
+};
+
+/* 检查参数能否生成合法程序, 不合法时抛出 std::invalid_argument */
+auto ValidateOptions(const GeneratorOptions& options) -> void;
+
+/* 返回实际写出的字节数 */
+auto GenerateProgram(const GeneratorOptions& options, std::ostream& out)
+    -> size_t;
+
+/* 解析 "64K" "1M" "1G" 这样的大小, 格式错误或溢出时抛出 std::invalid_argument */
+auto ParseSize(const std::string& text) -> size_t;
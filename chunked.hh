@@ -0,0 +1,393 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* 不需要汇总信息时使用的度量 */
+template <typename T>
+struct NoMeasure {
+  struct Summary {
+    auto operator+=(const Summary&) -> Summary& { return *this; }
+  };
+  static auto Of(const T&) -> Summary { return {}; }
+};
+
+/* 分块存储的序列: 元素放在不超过 CHUNK_SIZE 个元素的块中, 复制序列时共享块,
+ * 修改时才复制被改动的块. 在任意位置替换、截断或拼接只改动边界上的块
+ * 以及块索引 (每块一项), 不移动其余元素.
+ * Measure 为每个元素给出可累加的 Summary, 用于按汇总值 (如行数) 定位元素 */
+template <typename T, typename Measure = NoMeasure<T>>
+class ChunkedVector {
+ public:
+  using Summary = typename Measure::Summary;
+  static constexpr size_t CHUNK_SIZE =
+      std::max<size_t>(64, 16384 / sizeof(T));
+
+  class const_iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+    auto operator*() const -> reference { return *_item; }
+    auto operator->() const -> pointer { return _item; }
+    auto operator[](difference_type n) const -> reference {
+      return *(*this + n);
+    }
+    auto operator++() -> const_iterator& {
+      if (++_item == _end) {
+        Seek(_chunk + 1, 0);
+      }
+      return *this;
+    }
+    auto operator++(int) -> const_iterator {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+    auto operator--() -> const_iterator& {
+      if (_item == _begin) {
+        Seek(_chunk - 1, _owner->_chunks[_chunk - 1].size - 1);
+      } else {
+        --_item;
+      }
+      return *this;
+    }
+    auto operator--(int) -> const_iterator {
+      auto it = *this;
+      --*this;
+      return it;
+    }
+    auto operator+=(difference_type n) -> const_iterator& {
+      return *this = _owner->IteratorAt(index() + n);
+    }
+    auto operator-=(difference_type n) -> const_iterator& {
+      return *this += -n;
+    }
+    auto operator+(difference_type n) const -> const_iterator {
+      return _owner->IteratorAt(index() + n);
+    }
+    auto operator-(difference_type n) const -> const_iterator {
+      return *this + -n;
+    }
+    friend auto operator+(difference_type n, const const_iterator& it)
+        -> const_iterator {
+      return it + n;
+    }
+    auto operator-(const const_iterator& other) const -> difference_type {
+      return difference_type(index()) - difference_type(other.index());
+    }
+    auto operator==(const const_iterator& other) const -> bool {
+      return _chunk == other._chunk && _item == other._item;
+    }
+    auto operator!=(const const_iterator& other) const -> bool {
+      return !(*this == other);
+    }
+    auto operator<(const const_iterator& other) const -> bool {
+      return index() < other.index();
+    }
+    auto operator>(const const_iterator& other) const -> bool {
+      return other < *this;
+    }
+    auto operator<=(const const_iterator& other) const -> bool {
+      return !(other < *this);
+    }
+    auto operator>=(const const_iterator& other) const -> bool {
+      return !(*this < other);
+    }
+
+   private:
+    friend class ChunkedVector;
+    const ChunkedVector* _owner = nullptr;
+    size_t _chunk = 0;
+    const T* _begin = nullptr;  // 当前块的首尾, 顺序访问时不必查块索引
+    const T* _end = nullptr;
+    const T* _item = nullptr;
+
+    const_iterator(const ChunkedVector* owner, size_t chunk, size_t offset)
+        : _owner(owner) {
+      Seek(chunk, offset);
+    }
+    /* 末尾迭代器的 _chunk 为块数, 指针为空 */
+    auto Seek(size_t chunk, size_t offset) -> void {
+      _chunk = chunk;
+      if (chunk == _owner->_chunks.size()) {
+        _begin = _end = _item = nullptr;
+        return;
+      }
+      const auto& entry = _owner->_chunks[chunk];
+      _begin = entry.items->data();
+      _end = _begin + entry.size;
+      _item = _begin + offset;
+    }
+    auto index() const -> size_t {
+      return _owner->ChunkBegin(_chunk) + (_item - _begin);
+    }
+  };
+  using iterator = const_iterator;
+
+  ChunkedVector() = default;
+  template <typename InputIt>
+  ChunkedVector(InputIt first, InputIt last) {
+    Replace(0, 0, first, last);
+  }
+
+  auto size() const -> size_t { return _ends.empty() ? 0 : _ends.back(); }
+  auto empty() const -> bool { return _chunks.empty(); }
+  auto begin() const -> const_iterator { return const_iterator(this, 0, 0); }
+  auto end() const -> const_iterator {
+    return const_iterator(this, _chunks.size(), 0);
+  }
+  auto operator[](size_t i) const -> const T& {
+    const auto chunk = ChunkOf(i);
+    return (*_chunks[chunk].items)[i - ChunkBegin(chunk)];
+  }
+  auto front() const -> const T& { return _chunks.front().items->front(); }
+  auto back() const -> const T& { return _chunks.back().items->back(); }
+
+  /* [0, i) 的汇总 */
+  auto Prefix(size_t i) const -> Summary {
+    if (i >= size()) {
+      return Total();
+    }
+    const auto chunk = ChunkOf(i);
+    auto summary = chunk ? _sums[chunk - 1] : Summary{};
+    const auto& items = *_chunks[chunk].items;
+    const auto count = i - ChunkBegin(chunk);
+    for (size_t k = 0; k < count; k++) {
+      summary += Measure::Of(items[k]);
+    }
+    return summary;
+  }
+  auto Total() const -> Summary { return _sums.empty() ? Summary{} : _sums.back(); }
+  /* 第一个满足 pred(Prefix(i + 1)) 的下标, 不存在时返回 size().
+   * pred 须对前缀汇总单调 */
+  template <typename Predicate>
+  auto Find(Predicate pred) const -> size_t {
+    const auto chunk = size_t(
+        std::partition_point(_sums.begin(), _sums.end(),
+                             [&](const auto& s) { return !pred(s); }) -
+        _sums.begin());
+    if (chunk == _chunks.size()) {
+      return size();
+    }
+    auto summary = chunk ? _sums[chunk - 1] : Summary{};
+    const auto& items = *_chunks[chunk].items;
+    for (size_t k = 0; k < items.size(); k++) {
+      summary += Measure::Of(items[k]);
+      if (pred(summary)) {
+        return ChunkBegin(chunk) + k;
+      }
+    }
+    return _ends[chunk];
+  }
+
+  auto push_back(T value) -> void {
+    if (_chunks.empty() || _chunks.back().size >= CHUNK_SIZE) {
+      _chunks.push_back({std::make_shared<Chunk>(), 0, Summary{}});
+      _chunks.back().items->reserve(CHUNK_SIZE);
+      _ends.push_back(size());
+      _sums.push_back(Total());
+    }
+    const auto summary = Measure::Of(value);
+    Mutable(_chunks.size() - 1).push_back(std::move(value));
+    _chunks.back().size++;
+    _chunks.back().summary += summary;
+    _ends.back()++;
+    _sums.back() += summary;
+  }
+  template <typename... Args>
+  auto emplace_back(Args&&... args) -> void {
+    push_back(T(std::forward<Args>(args)...));
+  }
+  auto clear() -> void {
+    _chunks.clear();
+    _ends.clear();
+    _sums.clear();
+  }
+  auto Set(size_t i, T value) -> void {
+    const auto chunk = ChunkOf(i);
+    Mutable(chunk)[i - ChunkBegin(chunk)] = std::move(value);
+    Resummarize(chunk);
+    Reindex(chunk);
+  }
+
+  /* 用 [first, last) 替换 [position, position + count) */
+  template <typename InputIt>
+  auto Replace(size_t position, size_t count, InputIt first, InputIt last)
+      -> void {
+    if (position == size() && count == 0) {
+      for (; first != last; ++first) {
+        push_back(*first);
+      }
+      return;
+    }
+    /* 把涉及的块与插入的元素合并后重新分块, 过小时并入后一块 */
+    auto chunk = ChunkOf(position);
+    auto last_chunk =
+        position + count == size() ? _chunks.size() - 1 : ChunkOf(position + count);
+    std::vector<T> items;
+    Take(chunk, 0, position - ChunkBegin(chunk), items);
+    items.insert(items.end(), first, last);
+    Take(last_chunk, position + count - ChunkBegin(last_chunk),
+         _chunks[last_chunk].size, items);
+    if (items.size() < CHUNK_SIZE / 2 && last_chunk + 1 < _chunks.size()) {
+      last_chunk++;
+      Take(last_chunk, 0, _chunks[last_chunk].size, items);
+    }
+    Splice(chunk, last_chunk + 1, std::move(items));
+  }
+  /* 删除下标 size 之后的元素 */
+  auto Truncate(size_t size) -> void {
+    Split(size);
+  }
+  /* 删除并返回下标 at 之后的元素, 整块直接移交 */
+  auto Split(size_t at) -> ChunkedVector {
+    ChunkedVector suffix;
+    if (at >= size()) {
+      return suffix;
+    }
+    auto chunk = ChunkOf(at);
+    const auto offset = at - ChunkBegin(chunk);
+    if (offset) {
+      std::vector<T> items;
+      Take(chunk, offset, _chunks[chunk].size, items);
+      suffix.AddChunk(std::move(items));
+      auto& head = Mutable(chunk);
+      head.erase(head.begin() + offset, head.end());
+      Resummarize(chunk);
+      chunk++;
+    }
+    suffix._chunks.insert(suffix._chunks.end(),
+                          std::make_move_iterator(_chunks.begin() + chunk),
+                          std::make_move_iterator(_chunks.end()));
+    _chunks.resize(chunk);
+    _ends.resize(chunk);
+    _sums.resize(chunk);
+    suffix.Reindex(0);
+    Reindex(chunk ? chunk - 1 : 0);
+    return suffix;
+  }
+  /* 把 other 的块接到末尾 */
+  auto Append(ChunkedVector&& other) -> void {
+    if (other.empty()) {
+      return;
+    }
+    auto first = _chunks.size();
+    if (first &&
+        _chunks.back().size + other._chunks.front().size <= CHUNK_SIZE) {
+      const auto& items = *other._chunks.front().items;
+      auto& chunk = Mutable(first - 1);
+      chunk.insert(chunk.end(), items.begin(), items.end());
+      Resummarize(first - 1);
+      other._chunks.erase(other._chunks.begin());
+      first--;
+    }
+    _chunks.insert(_chunks.end(), std::make_move_iterator(other._chunks.begin()),
+                   std::make_move_iterator(other._chunks.end()));
+    other.clear();
+    Reindex(first);
+  }
+
+ private:
+  using Chunk = std::vector<T>;
+  /* 块的元素个数与汇总放在索引里, 重算索引时只需顺序扫描索引本身 */
+  struct Entry {
+    std::shared_ptr<Chunk> items;
+    size_t size;
+    Summary summary;
+  };
+  std::vector<Entry> _chunks;
+  std::vector<size_t> _ends;    // 每块末尾元素之后的下标
+  std::vector<Summary> _sums;   // 截至每块末尾的汇总
+
+  auto ChunkBegin(size_t chunk) const -> size_t {
+    return chunk ? _ends[chunk - 1] : 0;
+  }
+  auto ChunkOf(size_t i) const -> size_t {
+    return std::upper_bound(_ends.begin(), _ends.end(), i) - _ends.begin();
+  }
+  auto IteratorAt(size_t i) const -> const_iterator {
+    if (i >= size()) {
+      return end();
+    }
+    const auto chunk = ChunkOf(i);
+    return const_iterator(this, chunk, i - ChunkBegin(chunk));
+  }
+  /* 写时复制: 块被其他序列共享时先复制一份 */
+  auto Mutable(size_t chunk) -> Chunk& {
+    auto& items = _chunks[chunk].items;
+    if (items.use_count() > 1) {
+      items = std::make_shared<Chunk>(*items);
+    }
+    return *items;
+  }
+  /* 取出块内 [from, to) 的元素, 块不被共享时直接移动 */
+  auto Take(size_t chunk, size_t from, size_t to, std::vector<T>& items)
+      -> void {
+    auto& source = *_chunks[chunk].items;
+    if (_chunks[chunk].items.use_count() == 1) {
+      items.insert(items.end(), std::make_move_iterator(source.begin() + from),
+                   std::make_move_iterator(source.begin() + to));
+    } else {
+      items.insert(items.end(), source.begin() + from, source.begin() + to);
+    }
+  }
+  auto AddChunk(std::vector<T> items) -> void {
+    _chunks.push_back(
+        {std::make_shared<Chunk>(std::move(items)), 0, Summary{}});
+    Resummarize(_chunks.size() - 1);
+  }
+  auto Resummarize(size_t chunk) -> void {
+    auto& entry = _chunks[chunk];
+    entry.size = entry.items->size();
+    entry.summary = Summary{};
+    for (const auto& item : *entry.items) {
+      entry.summary += Measure::Of(item);
+    }
+  }
+  /* 用 items 重新分块后替换 [first, last) 块 */
+  auto Splice(size_t first, size_t last, std::vector<T> items) -> void {
+    const auto pieces = (items.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<Entry> chunks;
+    for (size_t k = 0; k < pieces; k++) {
+      const auto begin = items.size() * k / pieces;
+      const auto end = items.size() * (k + 1) / pieces;
+      Entry entry{std::make_shared<Chunk>(
+                      std::make_move_iterator(items.begin() + begin),
+                      std::make_move_iterator(items.begin() + end)),
+                  end - begin, Summary{}};
+      for (const auto& item : *entry.items) {
+        entry.summary += Measure::Of(item);
+      }
+      chunks.push_back(std::move(entry));
+    }
+    /* 块数不变时原地替换, 不移动之后的索引项 */
+    const auto common = std::min(chunks.size(), last - first);
+    std::move(chunks.begin(), chunks.begin() + common, _chunks.begin() + first);
+    if (chunks.size() > common) {
+      _chunks.insert(_chunks.begin() + last,
+                     std::make_move_iterator(chunks.begin() + common),
+                     std::make_move_iterator(chunks.end()));
+    } else {
+      _chunks.erase(_chunks.begin() + first + common, _chunks.begin() + last);
+    }
+    Reindex(first);
+  }
+  /* 从第 first 块起重算块索引 */
+  auto Reindex(size_t first) -> void {
+    _ends.resize(_chunks.size());
+    _sums.resize(_chunks.size());
+    for (auto chunk = first; chunk < _chunks.size(); chunk++) {
+      _ends[chunk] = ChunkBegin(chunk) + _chunks[chunk].size;
+      _sums[chunk] = chunk ? _sums[chunk - 1] : Summary{};
+      _sums[chunk] += _chunks[chunk].summary;
+    }
+  }
+};
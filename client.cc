@@ -0,0 +1,108 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "protocol.hh"
+
+/* 输出文件与源文件同名, 只替换扩展名 */
+static auto Stem(const std::string& path) -> std::string {
+  const auto slash = path.rfind('/');
+  const auto name = slash == std::string::npos ? 0 : slash + 1;
+  const auto dot = path.rfind('.');
+  /* 只去掉文件名中的扩展名, 目录名中的点与 ".pas" 这样的隐藏文件名保留 */
+  if (dot == std::string::npos || dot <= name) {
+    return path;
+  }
+  return path.substr(0, dot);
+}
+
+/* 用法: client <source.pas> [socket]  或  client --stats [socket]
+ * 编译结果写到源码旁的 .err/.dyd/.dys/.var/.pro 文件中 */
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <source.pas | --stats> [socket]"
+              << std::endl;
+    return 1;
+  }
+  const std::string target = argv[1];
+  const std::string socket_path = argc > 2 ? argv[2] : DEFAULT_SOCKET_PATH;
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address)) < 0) {
+    std::perror(("Failed to connect to " + socket_path).c_str());
+    return 1;
+  }
+
+  Status status;
+  std::string frame;
+  if (target == "--stats") {
+    const auto command = Command::STATS;
+    if (!WriteAll(fd, &command, sizeof(command)) ||
+        !ReadAll(fd, &status, sizeof(status)) ||
+        !ReadFrame(fd, frame, UINT32_MAX)) {
+      std::cerr << "Connection to compile server lost" << std::endl;
+      return 1;
+    }
+    std::cout << frame;
+    return 0;
+  }
+
+  std::ifstream inputFile(target);
+  if (!inputFile) {
+    std::cerr << "Cannot open " << target << std::endl;
+    return 1;
+  }
+  std::stringstream source;
+  source << inputFile.rdbuf();
+  if (source.str().size() > MAX_FRAME_SIZE) {
+    std::cerr << target << " exceeds the server limit of " << MAX_FRAME_SIZE
+              << " bytes" << std::endl;
+    return 1;
+  }
+  const auto command = Command::COMPILE;
+  if (!WriteAll(fd, &command, sizeof(command)) ||
+      !WriteFrame(fd, source.str()) || !ReadAll(fd, &status, sizeof(status))) {
+    std::cerr << "Connection to compile server lost" << std::endl;
+    return 1;
+  }
+
+  const auto stem = Stem(target);
+  /* 响应来自受信任的服务器, 不限制帧长度 */
+  for (const auto* suffix : {".err", ".dyd", ".dys", ".var", ".pro"}) {
+    if (!ReadFrame(fd, frame, UINT32_MAX)) {
+      std::cerr << "Connection to compile server lost" << std::endl;
+      return 1;
+    }
+    if (status != Status::OK && status != Status::PARSER_ERROR &&
+        frame.empty()) {
+      continue;
+    }
+    std::ofstream(stem + suffix) << frame;
+  }
+  ::close(fd);
+
+  if (status == Status::FRAME_TOO_LARGE) {
+    std::cerr << target << " was rejected by the server as too large"
+              << std::endl;
+    return 1;
+  }
+  if (status != Status::OK) {
+    std::cout << "Compiler aborted due to "
+              << (status == Status::LEXER_ERROR ? "lexer" : "parser")
+              << " error. A complete log of this run can be found in: " << stem
+              << ".err" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,401 @@
+#include "codegen.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+
+CodeGenerator::CodeGenerator(const Parser& parser)
+    : _parser(parser),
+      _executable(std::make_shared<Executable>()),
+      _cursor(parser.getResults().begin()),
+      _line(1),
+      _token_line(1),
+      _next_procedure(1) {
+  if (!parser.good()) {
+    throw std::runtime_error("Cannot generate code for a program with errors");
+  }
+  for (const auto& pro : parser.getProcedures()) {
+    const auto size = pro->_first_var_address == -1
+                          ? 0
+                          : pro->_last_val_address - pro->_first_var_address + 1;
+    _executable->procedures.push_back(
+        {pro->_name, pro->_level, -1, 1 + size, -1, false});
+  }
+  for (const auto& var : parser.getVariables()) {
+    if (var->_kind == 1) {
+      _executable->procedures[ProcedureIndex(var->_procedure)].param_offset =
+          VariableOffset(*var);
+    }
+  }
+
+  /* main: begin Declarations Executions end */
+  _parents.resize(_executable->procedures.size());
+  _procedure_stack.push_back(0);
+  _ends.resize(_executable->procedures.size());
+  Body(0);
+  _ends[0] = Emit(OpCode::HALT) + 1;
+  _executable->entry = _executable->procedures[0].entry;
+  Optimize();
+}
+
+/* 各函数访问了哪些函数的活动记录、调用了哪些函数 */
+auto CodeGenerator::Analyze() const -> std::vector<ProcedureUsage> {
+  const auto& code = _executable->code;
+  std::vector<ProcedureUsage> usages(_executable->procedures.size());
+  for (size_t p = 0; p < usages.size(); p++) {
+    auto& usage = usages[p];
+    for (auto pc = _executable->procedures[p].entry; pc < _ends[p]; pc++) {
+      switch (code[pc].op) {
+        case OpCode::LOAD:
+        case OpCode::STORE:
+        case OpCode::STORE_RESULT: {
+          usage.frames.insert(code[pc].a);
+          break;
+        }
+        case OpCode::CALL:
+        case OpCode::TAIL_CALL: {
+          usage.callees.insert(code[pc].a);
+          break;
+        }
+        case OpCode::READ:
+        case OpCode::WRITE:
+        case OpCode::WRITE_STRING: {
+          usage.io = true;
+          break;
+        }
+        default: {
+          break;
+        }
+      }
+    }
+  }
+  return usages;
+}
+
+/* 从 procedure 出发能调用到的所有函数, 包括它自己 */
+static auto Reachable(const std::vector<ProcedureUsage>& usages,
+                      int32_t procedure) -> std::set<int32_t> {
+  std::set<int32_t> reached = {procedure};
+  std::vector<int32_t> pending = {procedure};
+  while (!pending.empty()) {
+    const auto current = pending.back();
+    pending.pop_back();
+    for (const auto callee : usages[current].callees) {
+      if (reached.insert(callee).second) {
+        pending.push_back(callee);
+      }
+    }
+  }
+  return reached;
+}
+
+/* 尾调用: F 中 "F := P(...)" 之后只剩跳转直到 RETURN 时, CALL 改为
+ * TAIL_CALL, 在原地用 P 的活动记录替换 F 的. 只有当 P 能调用到的函数中
+ * 除 F 自身外都不访问 F 的活动记录时才安全.
+ * 记忆化: 只访问自己的活动记录、不做输入输出、只调用可记忆化函数的函数
+ * 其结果只取决于参数 */
+auto CodeGenerator::Optimize() -> void {
+  auto& code = _executable->code;
+  auto& procedures = _executable->procedures;
+  const auto usages = Analyze();
+  for (size_t f = 1; f < procedures.size(); f++) {
+    for (auto pc = procedures[f].entry; pc + 2 < _ends[f]; pc++) {
+      if (code[pc].op != OpCode::CALL || code[pc + 1].op != OpCode::STORE_RESULT ||
+          code[pc + 1].a != int32_t(f)) {
+        continue;
+      }
+      auto next = pc + 2;
+      while (code[next].op == OpCode::JUMP) {
+        next = code[next].a;
+      }
+      if (code[next].op != OpCode::RETURN) {
+        continue;
+      }
+      const auto reached = Reachable(usages, code[pc].a);
+      const auto safe =
+          std::none_of(reached.begin(), reached.end(), [&](int32_t q) {
+            return q != int32_t(f) && usages[q].frames.count(f);
+          });
+      if (safe) {
+        code[pc].op = OpCode::TAIL_CALL;
+      }
+    }
+  }
+
+  for (size_t p = 1; p < procedures.size(); p++) {
+    procedures[p].memoizable =
+        !usages[p].io && std::all_of(usages[p].frames.begin(),
+                                     usages[p].frames.end(),
+                                     [&](int32_t q) { return q == int32_t(p); });
+  }
+  for (auto changed = true; changed;) {
+    changed = false;
+    for (size_t p = 1; p < procedures.size(); p++) {
+      if (procedures[p].memoizable &&
+          std::any_of(usages[p].callees.begin(), usages[p].callees.end(),
+                      [&](int32_t q) { return !procedures[q].memoizable; })) {
+        procedures[p].memoizable = false;
+        changed = true;
+      }
+    }
+  }
+}
+
+auto CodeGenerator::Emit(OpCode op, int32_t a, int32_t b) -> int32_t {
+  _executable->code.push_back({op, a, b});
+  _executable->lines.push_back(_token_line);
+  return _executable->code.size() - 1;
+}
+
+auto CodeGenerator::Peek() -> const Token& {
+  while (_cursor->getType() == TokenType::END_OF_LINE) {
+    _cursor++;
+    _line++;
+  }
+  return *_cursor;
+}
+
+auto CodeGenerator::Next() -> const Token& {
+  const auto& token = Peek();
+  _token_line = _line;
+  _cursor++;
+  return token;
+}
+
+auto CodeGenerator::Expect(const TokenType& type) -> const Token& {
+  const auto& token = Next();
+  if (token.getType() != type) {
+    throw std::runtime_error("Expected " + std::string(TokenTypeToString(type)) +
+                             ", but got " + token.getText());
+  }
+  return token;
+}
+
+auto CodeGenerator::ProcedureIndex(
+    const std::shared_ptr<Procedure>& procedure) const -> int32_t {
+  const auto& procedures = _parser.getProcedures();
+  return std::find(procedures.begin(), procedures.end(), procedure) -
+         procedures.begin();
+}
+
+/* 沿外层函数链由内向外查找, 每个名字只绑定到声明它的作用域,
+ * 与 Parser 的查找规则一致 */
+auto CodeGenerator::FindVariable(const std::string& name) const
+    -> std::shared_ptr<class Variable> {
+  const auto& procedures = _parser.getProcedures();
+  const auto& variables = _parser.getVariables();
+  for (auto scope = _procedure_stack.rbegin(); scope != _procedure_stack.rend();
+       scope++) {
+    auto it = std::find_if(variables.begin(), variables.end(), [&](const auto& v) {
+      return v->_name == name && v->_procedure == procedures[*scope];
+    });
+    if (it != variables.end()) {
+      return *it;
+    }
+  }
+  return nullptr;
+}
+
+/* 只在已经说明过的、直接属于外层函数链的函数中查找 */
+auto CodeGenerator::FindProcedure(const std::string& name) const -> int32_t {
+  const auto& procedures = _parser.getProcedures();
+  for (auto scope = _procedure_stack.rbegin(); scope != _procedure_stack.rend();
+       scope++) {
+    for (size_t p = 1; p < _next_procedure; p++) {
+      if (_parents[p] == *scope && procedures[p]->_name == name) {
+        return p;
+      }
+    }
+  }
+  throw std::runtime_error("Variable or procedure '" + name +
+                           "' is not declared in an enclosing scope");
+}
+
+auto CodeGenerator::VariableOffset(const class Variable& variable) const
+    -> int32_t {
+  return 1 + variable._address - variable._procedure->_first_var_address;
+}
+
+/* 函数体的指令紧跟在其内部函数之后, 因此不需要跳过嵌套的函数 */
+auto CodeGenerator::Body(size_t procedure) -> void {
+  Expect(TokenType::BEGIN);
+  Declarations();
+  _executable->procedures[procedure].entry = _executable->code.size();
+  Executions();
+  Expect(TokenType::END);
+}
+
+auto CodeGenerator::Declarations() -> void {
+  while (Peek().getType() == TokenType::INTEGER) {
+    Next();
+    if (Peek().getType() == TokenType::FUNCTION) {
+      Next();
+      Next();  // 函数名
+      const auto procedure = _next_procedure++;
+      _parents[procedure] = _procedure_stack.back();
+      Expect(TokenType::L_PAREN);
+      Next();  // 参数名
+      Expect(TokenType::R_PAREN);
+      Expect(TokenType::SEMICOLON);
+      _procedure_stack.push_back(procedure);
+      Body(procedure);
+      _ends[procedure] = Emit(OpCode::RETURN) + 1;
+      _procedure_stack.pop_back();
+    } else {
+      Next();  // 变量名
+    }
+    Expect(TokenType::SEMICOLON);
+  }
+}
+
+auto CodeGenerator::Executions() -> void {
+  Execution();
+  while (Peek().getType() == TokenType::SEMICOLON) {
+    Next();
+    Execution();
+  }
+}
+
+auto CodeGenerator::Execution() -> void {
+  const auto& token = Next();
+  switch (token.getType()) {
+    case TokenType::READ:
+    case TokenType::WRITE: {
+      Expect(TokenType::L_PAREN);
+      if (Peek().getType() == TokenType::STRING) {
+        const auto& literal = Next().getText();
+        std::string text;
+        for (size_t i = 1; i + 1 < literal.size(); i++) {
+          text.push_back(literal[i]);
+          if (literal[i] == '\'') {
+            i++;  // '' 表示一个单引号
+          }
+        }
+        _executable->strings.push_back(std::move(text));
+        Emit(OpCode::WRITE_STRING, _executable->strings.size() - 1);
+        Expect(TokenType::R_PAREN);
+        break;
+      }
+      const auto& name = Expect(TokenType::IDENT).getText();
+      const auto var = FindVariable(name);
+      if (!var) {
+        throw std::runtime_error("Variable '" + name +
+                                 "' is not declared in an enclosing scope");
+      }
+      const auto procedure = ProcedureIndex(var->_procedure);
+      if (token.getType() == TokenType::READ) {
+        Emit(OpCode::READ);
+        Emit(OpCode::STORE, procedure, VariableOffset(*var));
+      } else {
+        Emit(OpCode::LOAD, procedure, VariableOffset(*var));
+        Emit(OpCode::WRITE);
+      }
+      Expect(TokenType::R_PAREN);
+      break;
+    }
+    case TokenType::IDENT: {
+      const auto var = FindVariable(token.getText());
+      const auto procedure = var ? 0 : FindProcedure(token.getText());
+      Expect(TokenType::ASSIGN);
+      Expression();
+      if (var) {
+        Emit(OpCode::STORE, ProcedureIndex(var->_procedure), VariableOffset(*var));
+      } else {
+        Emit(OpCode::STORE_RESULT, procedure);
+      }
+      break;
+    }
+    case TokenType::IF: {
+      Expression();
+      const auto op = Next().getType();
+      Expression();
+      switch (op) {
+        case TokenType::EQ: {
+          Emit(OpCode::EQ);
+          break;
+        }
+        case TokenType::NEQ: {
+          Emit(OpCode::NEQ);
+          break;
+        }
+        case TokenType::LT: {
+          Emit(OpCode::LT);
+          break;
+        }
+        case TokenType::LE: {
+          Emit(OpCode::LE);
+          break;
+        }
+        case TokenType::GT: {
+          Emit(OpCode::GT);
+          break;
+        }
+        default: {
+          Emit(OpCode::GE);
+          break;
+        }
+      }
+      const auto jump_else = Emit(OpCode::JUMP_IF_FALSE);
+      Expect(TokenType::THEN);
+      Execution();
+      const auto jump_end = Emit(OpCode::JUMP);
+      Expect(TokenType::ELSE);
+      _executable->code[jump_else].a = _executable->code.size();
+      Execution();
+      _executable->code[jump_end].a = _executable->code.size();
+      break;
+    }
+    default: {
+      throw std::runtime_error("Execution cannot begin with " + token.getText());
+    }
+  }
+}
+
+auto CodeGenerator::Expression() -> void {
+  Term();
+  while (Peek().getType() == TokenType::MINUS) {
+    Next();
+    Term();
+    Emit(OpCode::SUB);
+  }
+}
+
+auto CodeGenerator::Term() -> void {
+  Factor();
+  while (Peek().getType() == TokenType::MUL) {
+    Next();
+    Factor();
+    Emit(OpCode::MUL);
+  }
+}
+
+auto CodeGenerator::Factor() -> void {
+  const auto& token = Next();
+  if (token.getType() == TokenType::NUMBER) {
+    const auto& text = token.getText();
+    int64_t value;
+    const auto end = text.data() + text.size();
+    if (std::from_chars(text.data(), end, value).ec != std::errc()) {
+      throw std::runtime_error("Number out of range: " + text);
+    }
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+      Emit(OpCode::PUSH, value);
+    } else {
+      _executable->constants.push_back(value);
+      Emit(OpCode::PUSH_CONSTANT, _executable->constants.size() - 1);
+    }
+    return;
+  }
+  const auto var = FindVariable(token.getText());
+  if (var) {
+    Emit(OpCode::LOAD, ProcedureIndex(var->_procedure), VariableOffset(*var));
+    return;
+  }
+  const auto procedure = FindProcedure(token.getText());
+  Expect(TokenType::L_PAREN);
+  Expression();
+  Expect(TokenType::R_PAREN);
+  Emit(OpCode::CALL, procedure);
+}
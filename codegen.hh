@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "lexer.hh"
+#include "parser.hh"
+
+enum class OpCode : uint8_t {
+  PUSH,           // 压入常量 a
+  PUSH_CONSTANT,  // 压入常量池中第 a 个常量, 用于放不进 a 的大常量
+  LOAD,           // 压入函数 a 当前活动记录中偏移 b 处的变量
+  STORE,          // 弹出并写入函数 a 当前活动记录中偏移 b 处的变量
+  STORE_RESULT,   // 弹出并写入函数 a 当前活动记录的返回值
+  SUB,
+  MUL,
+  EQ,
+  NEQ,
+  LT,
+  LE,
+  GT,
+  GE,
+  JUMP,           // 跳转到 a
+  JUMP_IF_FALSE,  // 弹出, 为 0 时跳转到 a
+  CALL,           // 弹出实参, 调用函数 a
+  TAIL_CALL,      // 弹出实参, 用函数 a 的活动记录替换当前的并调用
+  RETURN,         // 返回当前活动记录的返回值
+  READ,           // 读入一个整数并压入
+  WRITE,          // 弹出并输出
+  WRITE_STRING,   // 输出字符串常量 a
+  HALT
+};
+
+struct Instruction {
+  OpCode op;
+  int32_t a;
+  int32_t b;
+};
+
+/* 运行时的函数信息, 下标与 Parser 的 _procedures 一致, 0 为 main */
+struct ProcedureCode {
+  std::string name;
+  size_t level;
+  int32_t entry;         // 第一条指令的位置
+  int32_t frame_size;    // 活动记录大小: 返回值 + [first_var, last_val] 的变量
+  int32_t param_offset;  // 参数在活动记录中的偏移, main 为 -1
+  bool memoizable;       // 结果只取决于参数
+};
+
+/* 编译后的程序, 生成后不再修改, 可在多个线程间共享 */
+struct Executable {
+  std::vector<Instruction> code;
+  std::vector<int> lines;  // 每条指令对应的源码行号
+  std::vector<ProcedureCode> procedures;
+  std::vector<std::string> strings;  // 去掉引号后的字符串常量
+  std::vector<int64_t> constants;    // 超出 int32_t 范围的整数常量
+  int32_t entry;
+};
+
+struct ProcedureUsage {
+  std::set<int32_t> frames;   // 访问了哪些函数的活动记录
+  std::set<int32_t> callees;
+  bool io = false;
+};
+
+/* 对语法分析通过的程序再做一遍递归下降, 生成栈式虚拟机指令.
+ * 名字按静态作用域沿外层函数链解析 */
+class CodeGenerator {
+ public:
+  CodeGenerator(const Parser& parser);
+  auto getExecutable() const -> std::shared_ptr<const Executable> {
+    return _executable;
+  }
+
+ private:
+  const Parser& _parser;
+  std::shared_ptr<Executable> _executable;
+  TokenSequence::const_iterator _cursor;
+  int _line;
+  int _token_line;  // 最近读入的 token 所在行, 作为生成指令的行号
+  size_t _next_procedure;  // 下一个函数说明在 _procedures 中的下标
+  std::vector<size_t> _procedure_stack;  // 外层函数链, 末尾为当前函数
+  std::vector<size_t> _parents;          // 每个函数直接所在的函数
+  std::vector<int32_t> _ends;  // 每个函数自身指令的结束位置
+
+  auto Analyze() const -> std::vector<ProcedureUsage>;
+  auto Optimize() -> void;
+  auto Emit(OpCode op, int32_t a = 0, int32_t b = 0) -> int32_t;
+  auto Peek() -> const Token&;
+  auto Next() -> const Token&;
+  auto Expect(const TokenType& type) -> const Token&;
+
+  auto ProcedureIndex(const std::shared_ptr<Procedure>& procedure) const
+      -> int32_t;
+  auto FindVariable(const std::string& name) const
+      -> std::shared_ptr<class Variable>;
+  auto FindProcedure(const std::string& name) const -> int32_t;
+  auto VariableOffset(const class Variable& variable) const -> int32_t;
+
+  auto Body(size_t procedure) -> void;
+  auto Declarations() -> void;
+  auto Executions() -> void;
+  auto Execution() -> void;
+  auto Expression() -> void;
+  auto Term() -> void;
+  auto Factor() -> void;
+};
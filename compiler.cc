@@ -0,0 +1,62 @@
+#include "compiler.hh"
+
+#include <string>
+#include <string_view>
+
+namespace uestc {
+
+static auto CopyDiagnostics(const Diagnostics& diagnostics,
+                            std::pmr::vector<DiagnosticEntry>& entries)
+    -> void {
+  entries.reserve(diagnostics.size());
+  for (const auto& d : diagnostics.getDiagnostics()) {
+    entries.push_back({d._severity, d._code, d._line, d._index,
+                       std::pmr::string(d.message(), entries.get_allocator())});
+  }
+}
+
+static auto CopyTokens(const TokenSequence& tokens,
+                       std::pmr::vector<TokenEntry>& entries) -> void {
+  entries.reserve(tokens.size());
+  for (const auto& token : tokens) {
+    entries.push_back({token.getType(),
+                       std::pmr::string(token.getText(), entries.get_allocator())});
+  }
+}
+
+auto compile(std::string_view source, const Options& options) -> Result {
+  Result result(options.resource);
+  const auto allocator = result.diagnostics.get_allocator();
+
+  Diagnostics diagnostics(options.max_errors);
+  Lexer lexer(SplitWords(source), diagnostics);
+  result.lexer_good = lexer.good();
+  CopyTokens(lexer.getTokens(), result.tokens);
+  if (!result.lexer_good && !options.parse_on_lexer_error) {
+    CopyDiagnostics(diagnostics, result.diagnostics);
+    return result;
+  }
+
+  Parser parser(lexer.getTokens(), diagnostics, options.imports);
+  result.parser_good = parser.good();
+  CopyDiagnostics(diagnostics, result.diagnostics);
+  CopyTokens(parser.getResults(), result.results);
+
+  result.variables.reserve(parser.getVariables().size());
+  for (const auto& var : parser.getVariables()) {
+    result.variables.push_back({std::pmr::string(var->_name, allocator),
+                                std::pmr::string(var->_procedure->_name, allocator),
+                                var->_kind, var->_type, var->_level,
+                                var->_address});
+  }
+  result.procedures.reserve(parser.getProcedures().size());
+  for (const auto& pro : parser.getProcedures()) {
+    result.procedures.push_back({std::pmr::string(pro->_name, allocator),
+                                 pro->_type, pro->_level,
+                                 pro->_first_var_address,
+                                 pro->_last_val_address});
+  }
+  return result;
+}
+
+}  // namespace uestc
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+
+#include "diagnostics.hh"
+#include "lexer.hh"
+#include "module.hh"
+#include "parser.hh"
+
+/* 可嵌入的编译接口: 不读写文件, 不依赖全局可变状态, 可在多个线程中同时调用.
+ * 对外的名字都放在 uestc 命名空间中, 以免与调用方的 Options/Result 等冲突 */
+namespace uestc {
+
+struct Options {
+  /* 结果中所有容器与字符串都从这里分配 */
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+  /* 词法分析出错时是否仍然进行语法分析 (命令行程序会直接中止) */
+  bool parse_on_lexer_error = false;
+  /* 错误数量上限, 0 表示不限制 */
+  size_t max_errors = 0;
+  /* 已 mmap 的模块接口, 其中的函数可以直接调用 */
+  std::vector<const ModuleInterface*> imports;
+};
+
+struct DiagnosticEntry {
+  Severity severity;
+  DiagnosticCode code;
+  int line;
+  int index;
+  std::pmr::string message;
+};
+
+struct TokenEntry {
+  TokenType type;
+  std::pmr::string text;
+};
+
+struct VariableEntry {
+  std::pmr::string name;
+  std::pmr::string procedure;
+  bool kind;  // 0 for var 1 for param
+  Type type;
+  size_t level;
+  int address;
+};
+
+struct ProcedureEntry {
+  std::pmr::string name;
+  Type type;
+  size_t level;
+  int first_var_address;
+  int last_val_address;
+};
+
+struct Result {
+  explicit Result(std::pmr::memory_resource* resource)
+      : tokens(resource),
+        results(resource),
+        variables(resource),
+        procedures(resource),
+        diagnostics(resource) {}
+
+  bool lexer_good = false;
+  bool parser_good = false;
+  std::pmr::vector<TokenEntry> tokens;   // 词法分析结果 (.dyd)
+  std::pmr::vector<TokenEntry> results;  // 语法分析结果 (.dys)
+  std::pmr::vector<VariableEntry> variables;
+  std::pmr::vector<ProcedureEntry> procedures;
+  std::pmr::vector<DiagnosticEntry> diagnostics;
+
+  auto good() const -> bool { return lexer_good && parser_good; }
+};
+
+auto compile(std::string_view source, const Options& options = {}) -> Result;
+
+}  // namespace uestc
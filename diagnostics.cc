@@ -0,0 +1,364 @@
+#include "diagnostics.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <utility>
+
+auto SeverityToString(const Severity& severity) -> const char* {
+  switch (severity) {
+    case Severity::ERROR:
+      return "error";
+    case Severity::WARNING:
+      return "warning";
+    case Severity::NOTE:
+      return "note";
+  }
+  return "error";
+}
+
+auto DiagnosticCodeToString(const DiagnosticCode& code) -> const char* {
+  switch (code) {
+    case DiagnosticCode::IDENT_TOO_LONG:
+      return "IDENT_TOO_LONG";
+    case DiagnosticCode::EXPECTED_EQ_AFTER_COLON:
+      return "EXPECTED_EQ_AFTER_COLON";
+    case DiagnosticCode::INVALID_CHARACTER:
+      return "INVALID_CHARACTER";
+    case DiagnosticCode::UNTERMINATED_COMMENT:
+      return "UNTERMINATED_COMMENT";
+    case DiagnosticCode::UNTERMINATED_STRING:
+      return "UNTERMINATED_STRING";
+    case DiagnosticCode::NUMBER_TOO_LARGE:
+      return "NUMBER_TOO_LARGE";
+    case DiagnosticCode::MISSING_SYMBOL:
+      return "MISSING_SYMBOL";
+    case DiagnosticCode::EXPECTED_TOKEN:
+      return "EXPECTED_TOKEN";
+    case DiagnosticCode::UNMATCHED_PAREN:
+      return "UNMATCHED_PAREN";
+    case DiagnosticCode::INVALID_VARIABLE_NAME:
+      return "INVALID_VARIABLE_NAME";
+    case DiagnosticCode::UNDEFINED_PROCEDURE:
+      return "UNDEFINED_PROCEDURE";
+    case DiagnosticCode::INVALID_EXECUTION:
+      return "INVALID_EXECUTION";
+    case DiagnosticCode::UNDEFINED_SYMBOL:
+      return "UNDEFINED_SYMBOL";
+    case DiagnosticCode::EXPECTED_FACTOR:
+      return "EXPECTED_FACTOR";
+    case DiagnosticCode::NOT_AN_OPERATOR:
+      return "NOT_AN_OPERATOR";
+    case DiagnosticCode::DUPLICATE_VARIABLE:
+      return "DUPLICATE_VARIABLE";
+    case DiagnosticCode::DUPLICATE_PARAMETER:
+      return "DUPLICATE_PARAMETER";
+    case DiagnosticCode::UNDECLARED_VARIABLE:
+      return "UNDECLARED_VARIABLE";
+    case DiagnosticCode::DUPLICATE_PROCEDURE:
+      return "DUPLICATE_PROCEDURE";
+    case DiagnosticCode::TOO_MANY_ERRORS:
+      return "TOO_MANY_ERRORS";
+    case DiagnosticCode::CHECKING_STOPPED:
+      return "CHECKING_STOPPED";
+  }
+  return "UNKNOWN";
+}
+
+/* 消息模板, %0 %1 ... 为参数占位符 */
+static auto DiagnosticTemplate(const DiagnosticCode& code) -> const char* {
+  switch (code) {
+    case DiagnosticCode::IDENT_TOO_LONG:
+      return "Ident out of length: '%0'";
+    case DiagnosticCode::EXPECTED_EQ_AFTER_COLON:
+      return "Expected '=' after ':'";
+    case DiagnosticCode::INVALID_CHARACTER:
+      return "Invalid character: '%0'";
+    case DiagnosticCode::UNTERMINATED_COMMENT:
+      return "Unterminated comment";
+    case DiagnosticCode::UNTERMINATED_STRING:
+      return "Unterminated string: %0";
+    case DiagnosticCode::NUMBER_TOO_LARGE:
+      return "Number out of range: '%0'";
+    case DiagnosticCode::MISSING_SYMBOL:
+      return "Missing symbol %0";
+    case DiagnosticCode::EXPECTED_TOKEN:
+      return "Expected %0, but got %1";
+    case DiagnosticCode::UNMATCHED_PAREN:
+      return "Unmatched '(', expected ')'";
+    case DiagnosticCode::INVALID_VARIABLE_NAME:
+      return "Invalid variable name %0";
+    case DiagnosticCode::UNDEFINED_PROCEDURE:
+      return "Undefined procedure '%0'";
+    case DiagnosticCode::INVALID_EXECUTION:
+      return "Execution cannot begin with %0";
+    case DiagnosticCode::UNDEFINED_SYMBOL:
+      return "Undefined variable or procedure %0";
+    case DiagnosticCode::EXPECTED_FACTOR:
+      return "Expect variable, procedure or constant, but got %0";
+    case DiagnosticCode::NOT_AN_OPERATOR:
+      return "'%0' is not an operator";
+    case DiagnosticCode::DUPLICATE_VARIABLE:
+      return "Variable '%0' has already been declared";
+    case DiagnosticCode::DUPLICATE_PARAMETER:
+      return "Parameter '%0' has already been declared";
+    case DiagnosticCode::UNDECLARED_VARIABLE:
+      return "Variable '%0' has not been declared";
+    case DiagnosticCode::DUPLICATE_PROCEDURE:
+      return "Procedure '%0' has already been declared";
+    case DiagnosticCode::TOO_MANY_ERRORS:
+      return "Too many errors, %0 more not shown";
+    case DiagnosticCode::CHECKING_STOPPED:
+      return "Too many errors, checking stopped at line %0%1";
+  }
+  return "";
+}
+
+auto Diagnostic::message() const -> std::string {
+  std::string result;
+  for (const char* p = DiagnosticTemplate(_code); *p; p++) {
+    if (p[0] == '%' && std::isdigit(p[1])) {
+      const size_t arg = p[1] - '0';
+      if (arg < _args.size()) {
+        result += _args[arg];
+      }
+      p++;
+    } else {
+      result += *p;
+    }
+  }
+  return result;
+}
+
+static auto DeduplicationKey(const Diagnostic& diagnostic) -> std::string {
+  auto key = std::to_string(int(diagnostic._code)) + ":" +
+             std::to_string(diagnostic._line) + ":" +
+             std::to_string(diagnostic._index);
+  for (const auto& arg : diagnostic._args) {
+    key += '\0';
+    key += arg;
+  }
+  return key;
+}
+
+auto Diagnostics::Report(const Severity& severity, const DiagnosticCode& code,
+                         int line, int index, std::vector<std::string> args)
+    -> void {
+  Add(Diagnostic{severity, code, line, index, std::move(args)});
+}
+
+auto Diagnostics::Add(Diagnostic diagnostic) -> bool {
+  const bool is_error = diagnostic._severity == Severity::ERROR;
+  if ((is_error && full()) ||
+      diagnostic._code == DiagnosticCode::CHECKING_STOPPED) {
+    _overflow.push_back(std::move(diagnostic));
+    return false;
+  }
+  if (_deduplicate && !_seen.insert(DeduplicationKey(diagnostic)).second) {
+    return false;
+  }
+  if (is_error) {
+    _errors++;
+  }
+  _diagnostics.push_back(std::move(diagnostic));
+  return true;
+}
+
+auto Diagnostics::RemoveLines(int first_line, int count, int delta) -> void {
+  const auto last_line = first_line + count;
+  _diagnostics.erase(
+      std::remove_if(_diagnostics.begin(), _diagnostics.end(),
+                     [&](const auto& d) {
+                       return d._line >= first_line && d._line < last_line;
+                     }),
+      _diagnostics.end());
+  _overflow.erase(
+      std::remove_if(_overflow.begin(), _overflow.end(),
+                     [&](const auto& d) {
+                       return d._line >= first_line && d._line < last_line;
+                     }),
+      _overflow.end());
+  for (auto* list : {&_diagnostics, &_overflow}) {
+    for (auto& diagnostic : *list) {
+      if (diagnostic._line >= last_line) {
+        diagnostic._line += delta;
+      }
+    }
+  }
+  Rebuild();
+}
+
+auto Diagnostics::Truncate(size_t size) -> std::vector<Diagnostic> {
+  std::vector<Diagnostic> removed(
+      std::make_move_iterator(_diagnostics.begin() + size),
+      std::make_move_iterator(_diagnostics.end()));
+  _diagnostics.erase(_diagnostics.begin() + size, _diagnostics.end());
+  /* 超出上限的错误都报告在保留的诊断之后 */
+  removed.insert(removed.end(), std::make_move_iterator(_overflow.begin()),
+                 std::make_move_iterator(_overflow.end()));
+  _overflow.clear();
+  Rebuild();
+  return removed;
+}
+
+/* 按报告顺序重新加入全部诊断, 删除后腾出的名额由之前超出上限的错误补上 */
+auto Diagnostics::Rebuild() -> void {
+  auto diagnostics = std::move(_diagnostics);
+  diagnostics.insert(diagnostics.end(),
+                     std::make_move_iterator(_overflow.begin()),
+                     std::make_move_iterator(_overflow.end()));
+  _diagnostics.clear();
+  _overflow.clear();
+  _errors = 0;
+  _seen.clear();
+  for (auto& diagnostic : diagnostics) {
+    Add(std::move(diagnostic));
+  }
+}
+
+static auto EscapeJson(const std::string& text) -> std::string {
+  std::string result;
+  for (const char c : text) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          result += buffer;
+        } else {
+          result += c;
+        }
+        break;
+    }
+  }
+  return result;
+}
+
+auto Diagnostics::Emit(std::ostream& out, const DiagnosticFormat& format,
+                       const std::string& source_path) const -> void {
+  std::ostringstream buffer;
+  switch (format) {
+    case DiagnosticFormat::TEXT: {
+      EmitText(buffer);
+      break;
+    }
+    case DiagnosticFormat::JSON: {
+      EmitJson(buffer);
+      break;
+    }
+    case DiagnosticFormat::SARIF: {
+      EmitSarif(buffer, source_path);
+      break;
+    }
+  }
+  const auto text = buffer.str();
+  out.write(text.data(), text.size());
+  out.flush();
+}
+
+/* 按行号稳定排序后输出, 超出上限时在末尾追加一条说明 */
+static auto Sorted(const std::vector<Diagnostic>& diagnostics,
+                   const Diagnostic* note) -> std::vector<const Diagnostic*> {
+  std::vector<const Diagnostic*> sorted;
+  for (const auto& diagnostic : diagnostics) {
+    sorted.push_back(&diagnostic);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](const auto a, const auto b) {
+    return a->_line < b->_line;
+  });
+  if (note) {
+    sorted.push_back(note);
+  }
+  return sorted;
+}
+
+auto Diagnostics::Stop(int line, int index) -> void {
+  Add(Diagnostic{Severity::NOTE, DiagnosticCode::CHECKING_STOPPED, line, index});
+}
+
+auto Diagnostics::TooManyErrors() const -> Diagnostic {
+  const auto stopped = std::find_if(
+      _overflow.begin(), _overflow.end(), [](const auto& d) {
+        return d._code == DiagnosticCode::CHECKING_STOPPED;
+      });
+  const auto more = _overflow.size() - (stopped != _overflow.end());
+  if (stopped == _overflow.end()) {
+    return Diagnostic{Severity::NOTE, DiagnosticCode::TOO_MANY_ERRORS, 0, 0,
+                      {std::to_string(more)}};
+  }
+  /* 停止前已有超出上限的词法错误时一并说明 */
+  return Diagnostic{
+      Severity::NOTE, DiagnosticCode::CHECKING_STOPPED, 0, 0,
+      {std::to_string(stopped->_line),
+       more ? ", " + std::to_string(more) + " more not shown" : ""}};
+}
+
+auto Diagnostics::EmitText(std::ostream& out) const -> void {
+  const auto note = TooManyErrors();
+  for (const auto* d : Sorted(_diagnostics, _overflow.empty() ? nullptr : &note)) {
+    if (d == &note) {
+      out << d->message() << "\n";
+      continue;
+    }
+    out << (d->_severity == Severity::ERROR     ? "Error"
+            : d->_severity == Severity::WARNING ? "Warning"
+                                                : "Note")
+        << " at line " << d->_line << ", index " << d->_index << ": "
+        << d->message() << "\n";
+  }
+}
+
+auto Diagnostics::EmitJson(std::ostream& out) const -> void {
+  const auto note = TooManyErrors();
+  out << "[";
+  bool first = true;
+  for (const auto* d : Sorted(_diagnostics, _overflow.empty() ? nullptr : &note)) {
+    out << (first ? "\n" : ",\n") << "  {\"severity\": \""
+        << SeverityToString(d->_severity) << "\", \"code\": \""
+        << DiagnosticCodeToString(d->_code) << "\", \"line\": " << d->_line
+        << ", \"index\": " << d->_index << ", \"message\": \""
+        << EscapeJson(d->message()) << "\"}";
+    first = false;
+  }
+  out << (first ? "]\n" : "\n]\n");
+}
+
+auto Diagnostics::EmitSarif(std::ostream& out,
+                            const std::string& source_path) const -> void {
+  const auto note = TooManyErrors();
+  out << "{\n  \"version\": \"2.1.0\",\n"
+         "  \"$schema\": \"https://json.schemastore.org/sarif-2.1.0.json\",\n"
+         "  \"runs\": [{\n"
+         "    \"tool\": {\"driver\": {\"name\": \"uestc-compiler\"}},\n"
+         "    \"results\": [";
+  bool first = true;
+  for (const auto* d : Sorted(_diagnostics, _overflow.empty() ? nullptr : &note)) {
+    out << (first ? "\n" : ",\n") << "      {\"ruleId\": \""
+        << DiagnosticCodeToString(d->_code) << "\", \"level\": \""
+        << SeverityToString(d->_severity) << "\", \"message\": {\"text\": \""
+        << EscapeJson(d->message()) << "\"}";
+    if (d->_line > 0) {
+      out << ", \"locations\": [{\"physicalLocation\": {"
+             "\"artifactLocation\": {\"uri\": \""
+          << EscapeJson(source_path) << "\"}, \"region\": {\"startLine\": "
+          << d->_line << "}}}]";
+    }
+    out << "}";
+    first = false;
+  }
+  out << (first ? "]\n" : "\n    ]\n") << "  }]\n}\n";
+}
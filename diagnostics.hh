@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+enum class Severity { ERROR, WARNING, NOTE };
+
+enum class DiagnosticCode {
+  /* 词法错误 */
+  IDENT_TOO_LONG,
+  EXPECTED_EQ_AFTER_COLON,
+  INVALID_CHARACTER,
+  UNTERMINATED_COMMENT,
+  UNTERMINATED_STRING,
+  NUMBER_TOO_LARGE,
+  /* 语法与语义错误 */
+  MISSING_SYMBOL,
+  EXPECTED_TOKEN,
+  UNMATCHED_PAREN,
+  INVALID_VARIABLE_NAME,
+  UNDEFINED_PROCEDURE,
+  INVALID_EXECUTION,
+  UNDEFINED_SYMBOL,
+  EXPECTED_FACTOR,
+  NOT_AN_OPERATOR,
+  DUPLICATE_VARIABLE,
+  DUPLICATE_PARAMETER,
+  UNDECLARED_VARIABLE,
+  DUPLICATE_PROCEDURE,
+  TOO_MANY_ERRORS,
+  /* 达到上限后停止分析的位置, 只记录在超出上限的列表中 */
+  CHECKING_STOPPED
+};
+
+enum class DiagnosticFormat { TEXT, JSON, SARIF };
+
+auto SeverityToString(const Severity& severity) -> const char*;
+auto DiagnosticCodeToString(const DiagnosticCode& code) -> const char*;
+
+/* 位置为行号 (1 起) 与该行内的 token 下标 (0 起) */
+class Diagnostic {
+ public:
+  Severity _severity;
+  DiagnosticCode _code;
+  int _line;
+  int _index;
+  std::vector<std::string> _args;
+
+  /* 用参数填充消息模板, 只在输出时调用 */
+  auto message() const -> std::string;
+};
+
+/* 先把诊断记录在内存中, 最后一次性按指定格式输出 */
+class Diagnostics {
+ public:
+  /* max_errors 为 0 表示不限制错误数量 */
+  Diagnostics(size_t max_errors = 0, bool deduplicate = true)
+      : _max_errors(max_errors), _deduplicate(deduplicate) {}
+  auto Report(const Severity& severity, const DiagnosticCode& code, int line,
+              int index, std::vector<std::string> args = {}) -> void;
+  /* 返回是否真正记录了这条诊断 (可能因重复或超出上限被丢弃) */
+  auto Add(Diagnostic diagnostic) -> bool;
+  /* 删除 [first_line, first_line + count) 行的诊断, 之后的行号平移 delta */
+  auto RemoveLines(int first_line, int count, int delta) -> void;
+  /* 删除第 size 条之后的诊断 (含超出上限的) 并按报告顺序返回它们 */
+  auto Truncate(size_t size) -> std::vector<Diagnostic>;
+  /* 错误达到上限而提前停止分析时记录停止的位置, 保证输出末尾的说明 */
+  auto Stop(int line, int index) -> void;
+  auto Emit(std::ostream& out, const DiagnosticFormat& format,
+            const std::string& source_path = "") const -> void;
+
+  auto size() const -> size_t { return _diagnostics.size(); }
+  auto errors() const -> size_t { return _errors; }
+  auto full() const -> bool { return _max_errors && _errors >= _max_errors; }
+  auto getDiagnostics() const -> const std::vector<Diagnostic>& {
+    return _diagnostics;
+  }
+
+ private:
+  size_t _max_errors;
+  bool _deduplicate;
+  size_t _errors = 0;
+  std::vector<Diagnostic> _diagnostics;
+  /* 超出上限未显示的错误, 保留下来以便增量重建后重新计数 */
+  std::vector<Diagnostic> _overflow;
+  std::unordered_set<std::string> _seen;
+
+  auto Rebuild() -> void;
+  auto TooManyErrors() const -> Diagnostic;
+  auto EmitText(std::ostream& out) const -> void;
+  auto EmitJson(std::ostream& out) const -> void;
+  auto EmitSarif(std::ostream& out, const std::string& source_path) const
+      -> void;
+};
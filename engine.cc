@@ -0,0 +1,388 @@
+#include "engine.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+auto JobStatusToString(const JobStatus& status) -> const char* {
+  switch (status) {
+    case JobStatus::OK:
+      return "ok";
+    case JobStatus::STEP_LIMIT:
+      return "step limit exceeded";
+    case JobStatus::DEPTH_LIMIT:
+      return "depth limit exceeded";
+    case JobStatus::INPUT_EXHAUSTED:
+      return "input exhausted";
+  }
+  return "unknown";
+}
+
+static auto MemoEntryOf(Context& context, size_t entries, int32_t procedure,
+                        int64_t argument) -> Context::MemoEntry& {
+  const auto hash = uint64_t(argument) * 0x9E3779B97F4A7C15ULL;
+  return context.memo[procedure * entries + (hash >> 32) % entries];
+}
+
+/* 剖析代码在编译期展开, 关闭时执行路径上没有任何额外开销 */
+template <bool Profiling>
+static auto Interpret(const Executable& executable, const Job& job,
+                      Context& context, Profile* profile) -> JobResult {
+  JobResult result;
+  auto& stack = context.stack;
+  auto& frames = context.frames;
+  auto& current = context.current_frame;
+  auto& calls = context.calls;
+  stack.clear();
+  frames.clear();
+  calls.clear();
+  current.resize(executable.procedures.size());
+  /* 每个函数先有一个静态活动记录, 未被调用的函数的变量也能访问 */
+  for (size_t i = 0; i < executable.procedures.size(); i++) {
+    current[i] = frames.size();
+    frames.resize(frames.size() + executable.procedures[i].frame_size);
+  }
+
+  if (job.memo_entries) {
+    const auto size = job.memo_entries * executable.procedures.size();
+    if (context.memo.size() != size) {
+      context.memo.assign(size, {});
+    }
+    context.generation++;  // 使上一个作业留下的表项全部失效
+  }
+
+  const auto* code = executable.code.data();
+  auto input = job.inputs.begin();
+  auto pc = executable.entry;
+  uint64_t steps = 0;
+  const auto max_steps = job.max_steps ? job.max_steps : UINT64_MAX;
+  if constexpr (Profiling) {
+    profile->Begin(pc, steps);
+  }
+  auto stop = [&](const JobStatus& status) {
+    if constexpr (Profiling) {
+      /* 步数用尽时 pc 处的指令尚未执行, 读入失败时 READ 已计入步数 */
+      profile->Finish(steps, status == JobStatus::STEP_LIMIT        ? pc
+                             : status == JobStatus::INPUT_EXHAUSTED ? pc + 1
+                                                                    : -1);
+    }
+    result.status = status;
+    result.steps = steps;
+    result.line = executable.lines[pc];
+    return result;
+  };
+  while (true) {
+    if (steps >= max_steps) {
+      return stop(JobStatus::STEP_LIMIT);
+    }
+    steps++;
+    const auto& instruction = code[pc];
+    switch (instruction.op) {
+      case OpCode::PUSH: {
+        stack.push_back(instruction.a);
+        break;
+      }
+      case OpCode::PUSH_CONSTANT: {
+        stack.push_back(executable.constants[instruction.a]);
+        break;
+      }
+      case OpCode::LOAD: {
+        stack.push_back(frames[current[instruction.a] + instruction.b]);
+        break;
+      }
+      case OpCode::STORE: {
+        frames[current[instruction.a] + instruction.b] = stack.back();
+        stack.pop_back();
+        break;
+      }
+      case OpCode::STORE_RESULT: {
+        frames[current[instruction.a]] = stack.back();
+        stack.pop_back();
+        break;
+      }
+      case OpCode::SUB:
+      case OpCode::MUL:
+      case OpCode::EQ:
+      case OpCode::NEQ:
+      case OpCode::LT:
+      case OpCode::LE:
+      case OpCode::GT:
+      case OpCode::GE: {
+        const auto rhs = stack.back();
+        stack.pop_back();
+        auto& lhs = stack.back();
+        switch (instruction.op) {
+          case OpCode::SUB:
+            lhs = int64_t(uint64_t(lhs) - uint64_t(rhs));
+            break;
+          case OpCode::MUL:
+            lhs = int64_t(uint64_t(lhs) * uint64_t(rhs));
+            break;
+          case OpCode::EQ:
+            lhs = lhs == rhs;
+            break;
+          case OpCode::NEQ:
+            lhs = lhs != rhs;
+            break;
+          case OpCode::LT:
+            lhs = lhs < rhs;
+            break;
+          case OpCode::LE:
+            lhs = lhs <= rhs;
+            break;
+          case OpCode::GT:
+            lhs = lhs > rhs;
+            break;
+          default:
+            lhs = lhs >= rhs;
+            break;
+        }
+        break;
+      }
+      case OpCode::JUMP: {
+        pc = instruction.a;
+        if constexpr (Profiling) {
+          profile->Branch(pc);
+        }
+        continue;
+      }
+      case OpCode::JUMP_IF_FALSE: {
+        const auto value = stack.back();
+        stack.pop_back();
+        if (!value) {
+          pc = instruction.a;
+          if constexpr (Profiling) {
+            profile->Branch(pc);
+          }
+          continue;
+        }
+        if constexpr (Profiling) {
+          profile->Branch(pc + 1);
+        }
+        break;
+      }
+      case OpCode::CALL:
+      case OpCode::TAIL_CALL: {
+        const auto& procedure = executable.procedures[instruction.a];
+        const auto argument = stack.back();
+        if (job.memo_entries && procedure.memoizable) {
+          const auto& entry = MemoEntryOf(context, job.memo_entries,
+                                          instruction.a, argument);
+          if (entry.generation == context.generation &&
+              entry.argument == argument) {
+            stack.back() = entry.value;
+            if constexpr (Profiling) {
+              profile->Branch(pc + 1);
+            }
+            break;
+          }
+        }
+        stack.pop_back();
+        if (instruction.op == OpCode::TAIL_CALL) {
+          /* 释放当前活动记录, 被调函数直接返回到当前函数的调用者 */
+          if constexpr (Profiling) {
+            profile->Leave(steps);
+          }
+          auto& call = calls.back();
+          frames.resize(current[call.procedure]);
+          current[call.procedure] = call.saved_frame;
+          call = {call.return_pc, instruction.a, current[instruction.a],
+                  argument};
+        } else {
+          if (job.max_depth && calls.size() >= job.max_depth) {
+            return stop(JobStatus::DEPTH_LIMIT);
+          }
+          calls.push_back(
+              {pc + 1, instruction.a, current[instruction.a], argument});
+        }
+        if constexpr (Profiling) {
+          profile->Enter(instruction.a, steps);
+        }
+        current[instruction.a] = frames.size();
+        frames.resize(frames.size() + procedure.frame_size);
+        frames[current[instruction.a] + procedure.param_offset] = argument;
+        pc = procedure.entry;
+        continue;
+      }
+      case OpCode::RETURN: {
+        if constexpr (Profiling) {
+          profile->Leave(steps);
+        }
+        const auto call = calls.back();
+        calls.pop_back();
+        const auto base = current[call.procedure];
+        if (job.memo_entries &&
+            executable.procedures[call.procedure].memoizable) {
+          MemoEntryOf(context, job.memo_entries, call.procedure,
+                      call.argument) = {call.argument, frames[base],
+                                        context.generation};
+        }
+        stack.push_back(frames[base]);
+        frames.resize(base);
+        current[call.procedure] = call.saved_frame;
+        pc = call.return_pc;
+        if constexpr (Profiling) {
+          profile->Branch(pc);
+        }
+        continue;
+      }
+      case OpCode::READ: {
+        if (input == job.inputs.end()) {
+          return stop(JobStatus::INPUT_EXHAUSTED);
+        }
+        stack.push_back(*input++);
+        break;
+      }
+      case OpCode::WRITE: {
+        result.outputs.push_back(std::to_string(stack.back()));
+        stack.pop_back();
+        break;
+      }
+      case OpCode::WRITE_STRING: {
+        result.outputs.push_back(executable.strings[instruction.a]);
+        break;
+      }
+      case OpCode::HALT: {
+        return stop(JobStatus::OK);
+      }
+    }
+    pc++;
+  }
+}
+
+auto Execute(const Executable& executable, const Job& job, Context& context,
+             Profile* profile) -> JobResult {
+  if (profile) {
+    return Interpret<true>(executable, job, context, profile);
+  }
+  return Interpret<false>(executable, job, context, nullptr);
+}
+
+ExecutionEngine::ExecutionEngine(std::shared_ptr<const Executable> executable,
+                                 size_t threads, const ProfileMode& mode)
+    : _executable(std::move(executable)), _mode(mode) {
+  if (_mode != ProfileMode::OFF) {
+    _profile = std::make_unique<Profile>(*_executable, _mode);
+  }
+  for (size_t i = 0; i < threads; i++) {
+    _queues.push_back(std::make_unique<Worker>());
+    if (_profile) {
+      _queues.back()->profile = std::make_unique<Profile>(*_executable, _mode);
+    }
+  }
+  for (size_t i = 0; i < threads; i++) {
+    _threads.emplace_back([this, i] { Work(i); });
+  }
+}
+
+ExecutionEngine::~ExecutionEngine() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _ready.notify_all();
+  for (auto& thread : _threads) {
+    thread.join();
+  }
+}
+
+auto ExecutionEngine::Run(const std::vector<Job>& jobs)
+    -> std::vector<JobResult> {
+  std::vector<JobResult> results(jobs.size());
+  const auto begin = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    /* 先轮流分给各个线程, 负载不均时再由空闲线程窃取 */
+    for (size_t i = 0; i < jobs.size(); i++) {
+      auto& worker = *_queues[i % _queues.size()];
+      std::lock_guard<std::mutex> queue_lock(worker.mutex);
+      worker.queue.push_back(i);
+    }
+    _jobs = &jobs;
+    _results = &results;
+    _remaining = jobs.size();
+    _generation++;
+  }
+  _ready.notify_all();
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    /* 等所有线程退出取任务的循环, 避免它们取到下一批作业时仍持有旧的指针 */
+    _done.wait(lock, [this] { return _remaining == 0 && _active == 0; });
+    _jobs = nullptr;
+    _results = nullptr;
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  if (_profile) {
+    for (auto& worker : _queues) {
+      _profile->Merge(*worker->profile);
+      worker->profile = std::make_unique<Profile>(*_executable, _mode);
+    }
+  }
+  _statistics.jobs += jobs.size();
+  for (const auto& result : results) {
+    _statistics.steps += result.steps;
+  }
+  _statistics.seconds += std::chrono::duration<double>(end - begin).count();
+  return results;
+}
+
+/* 优先从自己队列的尾部取, 否则从其他线程队列的头部窃取 */
+auto ExecutionEngine::Take(size_t id, size_t& job) -> bool {
+  {
+    auto& own = *_queues[id];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.queue.empty()) {
+      job = own.queue.back();
+      own.queue.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < _queues.size(); i++) {
+    auto& victim = *_queues[(id + i) % _queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.queue.empty()) {
+      job = victim.queue.front();
+      victim.queue.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+auto ExecutionEngine::Work(size_t id) -> void {
+  Context context;
+  size_t generation = 0;
+  while (true) {
+    const std::vector<Job>* jobs;
+    std::vector<JobResult>* results;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _ready.wait(lock,
+                  [&] { return _stopping || _generation != generation; });
+      if (_stopping) {
+        return;
+      }
+      generation = _generation;
+      if (!_jobs) {
+        continue;
+      }
+      _active++;
+      jobs = _jobs;
+      results = _results;
+    }
+    size_t job;
+    size_t finished = 0;
+    while (Take(id, job)) {
+      (*results)[job] = Execute(*_executable, (*jobs)[job], context,
+                                _queues[id]->profile.get());
+      finished++;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _remaining -= finished;
+    _active--;
+    if (_remaining == 0 && _active == 0) {
+      _done.notify_all();
+    }
+  }
+}
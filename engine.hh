@@ -0,0 +1,104 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "codegen.hh"
+#include "profiler.hh"
+
+/* 一次执行请求: 输入序列与资源上限 (0 表示不限制) */
+struct Job {
+  std::vector<int64_t> inputs;
+  uint64_t max_steps = 0;
+  size_t max_depth = 0;
+  size_t memo_entries = 0;  // 每个可记忆化函数的结果缓存大小, 0 表示不缓存
+};
+
+enum class JobStatus { OK, STEP_LIMIT, DEPTH_LIMIT, INPUT_EXHAUSTED };
+
+auto JobStatusToString(const JobStatus& status) -> const char*;
+
+struct JobResult {
+  JobStatus status = JobStatus::OK;
+  std::vector<std::string> outputs;
+  uint64_t steps = 0;
+  int line = 0;  // 停止时所在的源码行
+};
+
+/* 单个作业的运行时状态, 每个工作线程复用一份以避免重复分配 */
+class Context {
+ public:
+  struct Call {
+    int32_t return_pc;
+    int32_t procedure;
+    size_t saved_frame;
+    int64_t argument;
+  };
+  /* 直接映射的记忆化表项, generation 不等于当前作业的即为无效 */
+  struct MemoEntry {
+    int64_t argument = 0;
+    int64_t value = 0;
+    uint64_t generation = 0;
+  };
+
+  std::vector<int64_t> stack;
+  std::vector<int64_t> frames;
+  std::vector<size_t> current_frame;  // 每个函数当前活动记录在 frames 中的位置
+  std::vector<Call> calls;
+  std::vector<MemoEntry> memo;
+  uint64_t generation = 0;
+};
+
+/* 在 context 中执行一个作业, 程序本身只读. profile 非空时记录剖析数据 */
+auto Execute(const Executable& executable, const Job& job, Context& context,
+             Profile* profile = nullptr) -> JobResult;
+
+struct EngineStatistics {
+  size_t jobs = 0;
+  uint64_t steps = 0;
+  double seconds = 0;
+};
+
+/* 多个作业共享同一份编译结果的执行引擎, 工作线程之间相互窃取任务 */
+class ExecutionEngine {
+ public:
+  ExecutionEngine(std::shared_ptr<const Executable> executable, size_t threads,
+                  const ProfileMode& mode = ProfileMode::OFF);
+  ~ExecutionEngine();
+  auto Run(const std::vector<Job>& jobs) -> std::vector<JobResult>;
+  auto getStatistics() const -> const EngineStatistics& { return _statistics; }
+  /* 所有已完成作业合并后的剖析数据, 未开启剖析时为空 */
+  auto getProfile() const -> const Profile* { return _profile.get(); }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<size_t> queue;
+    std::unique_ptr<Profile> profile;  // 只由对应的工作线程写入
+  };
+
+  std::shared_ptr<const Executable> _executable;
+  ProfileMode _mode;
+  std::unique_ptr<Profile> _profile;
+  std::vector<std::unique_ptr<Worker>> _queues;
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  std::condition_variable _done;
+  const std::vector<Job>* _jobs = nullptr;
+  std::vector<JobResult>* _results = nullptr;
+  size_t _generation = 0;
+  size_t _remaining = 0;
+  size_t _active = 0;  // 正在取任务的线程数
+  bool _stopping = false;
+  EngineStatistics _statistics;
+
+  auto Work(size_t id) -> void;
+  auto Take(size_t id, size_t& job) -> bool;
+};
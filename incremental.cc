@@ -0,0 +1,99 @@
+#include "incremental.hh"
+
+#include <algorithm>
+#include <string_view>
+#include <stdexcept>
+#include <string>
+
+/* 由跨行注释的首尾行得到 lines 行中每行是否位于注释内 (起始行除外) */
+static auto CommentLines(size_t lines,
+                         const std::vector<std::pair<size_t, size_t>>& spans)
+    -> std::vector<char> {
+  std::vector<char> in_comment(lines);
+  for (const auto& span : spans) {
+    std::fill(in_comment.begin() + span.first + 1,
+              in_comment.begin() + span.second + 1, 1);
+  }
+  return in_comment;
+}
+
+/* 切分单词的同时标出位于跨行注释内的行 */
+static auto SplitSource(std::string_view source, ChunkedVector<char>& in_comment)
+    -> std::vector<std::string> {
+  std::vector<std::pair<size_t, size_t>> spans;
+  auto words = SplitWords(source, &spans);
+  const auto lines =
+      CommentLines(std::count(source.begin(), source.end(), '\n') + 1, spans);
+  in_comment = ChunkedVector<char>(lines.begin(), lines.end());
+  return words;
+}
+
+/* 未闭合的注释以单独的起始符作为单词留下, 见 SplitWords */
+static auto HasUnclosedComment(const std::vector<std::string>& words) -> bool {
+  return std::any_of(words.begin(), words.end(), [](const auto& word) {
+    return word == "{" || word == "(*";
+  });
+}
+
+IncrementalCompiler::IncrementalCompiler(const std::string& source)
+    : _source(source.begin(), source.end()),
+      _lexer(SplitSource(source, _in_comment), _lexer_diagnostics),
+      _parser(_lexer.getTokens(), _parser_diagnostics) {}
+
+auto IncrementalCompiler::LineOf(size_t offset) const -> size_t {
+  return _source.Prefix(offset).lines;
+}
+
+auto IncrementalCompiler::LineOffset(size_t line) const -> size_t {
+  if (line == 0) {
+    return 0;
+  }
+  return _source.Find([&](const auto& s) { return s.lines >= line; }) + 1;
+}
+
+/* 从 first_line 到 last_line 的整行文本 */
+auto IncrementalCompiler::LineText(size_t first_line, size_t last_line) const
+    -> std::string {
+  const auto begin = LineOffset(first_line);
+  const auto end = last_line < _source.Total().lines ? LineOffset(last_line + 1)
+                                                      : _source.size();
+  return std::string(_source.begin() + begin, _source.begin() + end);
+}
+
+auto IncrementalCompiler::Edit(size_t offset, size_t removed,
+                               const std::string& inserted) -> void {
+  if (offset > _source.size() || removed > _source.size() - offset) {
+    throw std::out_of_range("Edit range out of source");
+  }
+  /* 注释可以跨行: 把重新分析的范围扩大到完整包含所涉及的跨行注释,
+   * 这样范围前后的行是否位于注释内都不受这次编辑影响 */
+  auto first_line = LineOf(offset);
+  auto last_line = LineOf(offset + removed);
+  while (first_line > 0 && _in_comment[first_line]) {
+    first_line--;
+  }
+  while (last_line + 1 < _in_comment.size() && _in_comment[last_line + 1]) {
+    last_line++;
+  }
+  const auto removed_lines =
+      std::min(last_line + 1, _lexer.getLineCount()) - first_line;
+
+  /* 源码分块存放, 只替换涉及的块; 行号由换行符计数得出, 不必逐行平移 */
+  const auto old_lines = _source.Total().lines;
+  _source.Replace(offset, removed, inserted.begin(), inserted.end());
+  const auto new_last_line = last_line + _source.Total().lines - old_lines;
+  std::vector<std::pair<size_t, size_t>> spans;
+  auto words = SplitWords(LineText(first_line, new_last_line), &spans);
+
+  /* 新文本留下未闭合的注释且范围没有到达文件末尾时,
+   * 其后的行都成为注释, 整体重新分析 */
+  if (HasUnclosedComment(words) && new_last_line < _source.Total().lines) {
+    _parser.Update(_lexer.Relex(0, _lexer.getLineCount(),
+                                SplitSource(getSource(), _in_comment)));
+    return;
+  }
+  const auto lines = CommentLines(new_last_line - first_line + 1, spans);
+  _in_comment.Replace(first_line, last_line - first_line + 1, lines.begin(),
+                      lines.end());
+  _parser.Update(_lexer.Relex(first_line, removed_lines, words));
+}
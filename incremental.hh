@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "chunked.hh"
+#include "diagnostics.hh"
+#include "lexer.hh"
+#include "parser.hh"
+
+/* 供编辑器使用: 每次编辑只重新分析受影响的行与语句 */
+class IncrementalCompiler {
+ public:
+  IncrementalCompiler(const std::string& source);
+  /* 将 [offset, offset + removed) 替换为 inserted */
+  auto Edit(size_t offset, size_t removed, const std::string& inserted)
+      -> void;
+  auto getSource() const -> std::string {
+    return std::string(_source.begin(), _source.end());
+  }
+  auto getLexer() const -> const Lexer& { return _lexer; }
+  auto getParser() const -> const Parser& { return _parser; }
+  auto getLexerDiagnostics() const -> const Diagnostics& {
+    return _lexer_diagnostics;
+  }
+  auto getParserDiagnostics() const -> const Diagnostics& {
+    return _parser_diagnostics;
+  }
+
+ private:
+  /* 统计换行符, 行号与偏移由此互相换算 */
+  struct NewlineCount {
+    struct Summary {
+      size_t lines = 0;
+      auto operator+=(const Summary& other) -> Summary& {
+        lines += other.lines;
+        return *this;
+      }
+    };
+    static auto Of(char c) -> Summary { return {c == '\n'}; }
+  };
+
+  ChunkedVector<char, NewlineCount> _source;
+  ChunkedVector<char> _in_comment;  // 每行是否位于跨行注释内 (起始行除外)
+  /* 词法与语法诊断分开保存, 以便各自按行或按位置增量更新 */
+  Diagnostics _lexer_diagnostics;
+  Diagnostics _parser_diagnostics;
+  Lexer _lexer;
+  Parser _parser;
+
+  auto LineOf(size_t offset) const -> size_t;
+  auto LineOffset(size_t line) const -> size_t;
+  auto LineText(size_t first_line, size_t last_line) const -> std::string;
+};
@@ -1,43 +1,212 @@
 #include "lexer.hh"
 
+#include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <string>
 
-std::unordered_map<TokenType, std::string> TokenTypeToString = {
-    {TokenType::UNKNOWN, "UNKNOWN"},
-    {TokenType::BEGIN, "BEGIN"},
-    {TokenType::END, "END"},
-    {TokenType::INTEGER, "INTEGER"},
-    {TokenType::IF, "IF"},
-    {TokenType::THEN, "THEN"},
-    {TokenType::ELSE, "ELSE"},
-    {TokenType::FUNCTION, "FUNCTION"},
-    {TokenType::READ, "READ"},
-    {TokenType::WRITE, "WRITE"},
-    {TokenType::IDENT, "IDENT"},
-    {TokenType::NUMBER, "NUMBER"},
-    {TokenType::EQ, "EQ"},
-    {TokenType::NEQ, "NEQ"},
-    {TokenType::LE, "LE"},
-    {TokenType::LT, "LT"},
-    {TokenType::GE, "GE"},
-    {TokenType::GT, "GT"},
-    {TokenType::MINUS, "MINUS"},
-    {TokenType::MUL, "MUL"},
-    {TokenType::ASSIGN, "ASSIGN"},
-    {TokenType::L_PAREN, "L_PAREN"},
-    {TokenType::R_PAREN, "R_PAREN"},
-    {TokenType::SEMICOLON, "SEMICOLON"},
-    {TokenType::END_OF_LINE, "END_OF_LINE"},
-    {TokenType::END_OF_FILE, "END_OF_FILE"}};
+auto TokenTypeToString(const TokenType& type) -> const char* {
+  switch (type) {
+    case TokenType::UNKNOWN:
+      return "UNKNOWN";
+    case TokenType::BEGIN:
+      return "BEGIN";
+    case TokenType::END:
+      return "END";
+    case TokenType::INTEGER:
+      return "INTEGER";
+    case TokenType::IF:
+      return "IF";
+    case TokenType::THEN:
+      return "THEN";
+    case TokenType::ELSE:
+      return "ELSE";
+    case TokenType::FUNCTION:
+      return "FUNCTION";
+    case TokenType::READ:
+      return "READ";
+    case TokenType::WRITE:
+      return "WRITE";
+    case TokenType::IDENT:
+      return "IDENT";
+    case TokenType::NUMBER:
+      return "NUMBER";
+    case TokenType::EQ:
+      return "EQ";
+    case TokenType::NEQ:
+      return "NEQ";
+    case TokenType::LE:
+      return "LE";
+    case TokenType::LT:
+      return "LT";
+    case TokenType::GE:
+      return "GE";
+    case TokenType::GT:
+      return "GT";
+    case TokenType::MINUS:
+      return "MINUS";
+    case TokenType::MUL:
+      return "MUL";
+    case TokenType::ASSIGN:
+      return "ASSIGN";
+    case TokenType::L_PAREN:
+      return "L_PAREN";
+    case TokenType::R_PAREN:
+      return "R_PAREN";
+    case TokenType::SEMICOLON:
+      return "SEMICOLON";
+    case TokenType::END_OF_LINE:
+      return "END_OF_LINE";
+    case TokenType::END_OF_FILE:
+      return "END_OF_FILE";
+    case TokenType::STRING:
+      return "STRING";
+  }
+  return "UNKNOWN";
+}
+
+/* 查找注释结束符, 返回其后的位置, 找不到时返回 npos.
+ * 注释体不需要逐字符解释, 交给 memchr 按向量宽度扫描 */
+static auto FindCommentEnd(std::string_view source, size_t pos, bool brace)
+    -> size_t {
+  const auto* begin = source.data();
+  const auto* end = begin + source.size();
+  const auto* cursor = begin + pos;
+  while (cursor < end) {
+    const auto* found = static_cast<const char*>(
+        std::memchr(cursor, brace ? '}' : ')', end - cursor));
+    if (!found) {
+      break;
+    }
+    /* "(*)" 中的 ')' 不是结束符, 星号必须在注释体内 */
+    if (brace || (found - begin > long(pos) && found[-1] == '*')) {
+      return found - begin + 1;
+    }
+    cursor = found + 1;
+  }
+  return std::string_view::npos;
+}
+
+auto SplitWords(std::string_view source,
+                std::vector<std::pair<size_t, size_t>>* comment_spans)
+    -> std::vector<std::string> {
+  std::vector<std::string> words;
+  std::string word;
+  size_t line = 0;
+  auto flush = [&] {
+    if (!word.empty()) {
+      words.push_back(std::move(word));
+      word.clear();
+    }
+  };
+  size_t pos = 0;
+  while (pos < source.size()) {
+    const auto c = source[pos];
+    if (c == '\n') {
+      flush();
+      words.push_back("\n");
+      line++;
+      pos++;
+    } else if (std::isspace(static_cast<unsigned char>(c))) {
+      flush();
+      pos++;
+    } else if (c == '{' || (c == '(' && pos + 1 < source.size() &&
+                            source[pos + 1] == '*')) {
+      flush();
+      const auto brace = c == '{';
+      const auto end = FindCommentEnd(source, pos + (brace ? 1 : 2), brace);
+      if (end == std::string_view::npos) {
+        /* 未闭合: 留下起始符, 其余部分只保留换行以维持行号 */
+        words.push_back(brace ? "{" : "(*");
+        const auto lines = std::count(source.begin() + pos, source.end(), '\n');
+        for (long i = 0; i < lines; i++) {
+          words.push_back("\n");
+        }
+        if (comment_spans && lines) {
+          comment_spans->emplace_back(line, line + lines);
+        }
+        if (source.back() != '\n') {
+          words.push_back("\n");
+        }
+        return words;
+      }
+      const auto first_line = line;
+      for (auto i = std::count(source.begin() + pos, source.begin() + end, '\n');
+           i > 0; i--) {
+        words.push_back("\n");
+        line++;
+      }
+      if (comment_spans && line != first_line) {
+        comment_spans->emplace_back(first_line, line);
+      }
+      pos = end;
+    } else if (c == '\'') {
+      /* 字符串不跨行, '' 表示一个单引号 */
+      auto end = pos + 1;
+      while (end < source.size() && source[end] != '\n') {
+        if (source[end++] == '\'') {
+          if (end < source.size() && source[end] == '\'') {
+            end++;
+          } else {
+            break;
+          }
+        }
+      }
+      word.append(source.substr(pos, end - pos));
+      pos = end;
+    } else {
+      word.push_back(c);
+      pos++;
+    }
+  }
+  flush();
+  if (!source.empty() && source.back() != '\n') {
+    words.push_back("\n");
+  }
+  return words;
+}
+
+auto SplitWords(std::istream& input) -> std::vector<std::string> {
+  /* 可定位的流按剩余大小一次读入, 否则整块复制底层缓冲区 */
+  std::string source;
+  const auto begin = input.tellg();
+  if (begin != std::streampos(-1) && input.seekg(0, std::ios::end)) {
+    const auto end = input.tellg();
+    input.seekg(begin);
+    source.resize(size_t(end - begin));
+    input.read(source.data(), source.size());
+    source.resize(input.gcount());
+  } else if (input) {
+    input.clear();
+    std::ostringstream buffer;
+    buffer << input.rdbuf();
+    source = buffer.str();
+  }
+  return SplitWords(source);
+}
+
+const std::unordered_map<std::string, TokenType> Lexer::_table = {
+    {"begin", TokenType::BEGIN},       {"end", TokenType::END},
+    {"integer", TokenType::INTEGER},   {"if", TokenType::IF},
+    {"then", TokenType::THEN},         {"else", TokenType::ELSE},
+    {"function", TokenType::FUNCTION}, {"read", TokenType::READ},
+    {"write", TokenType::WRITE}};
 
-Lexer::Lexer(const std::vector<std::string>& words) {
-  _line = 1;
-  _flag = true;
+Lexer::Lexer(const std::vector<std::string>& words, Diagnostics& diagnostics,
+             int first_line)
+    : _diagnostics(diagnostics) {
+  _line = first_line;
+  _errors = 0;
+  _line_start = 0;
+  _line_errors.push_back(0);
   for (const auto& word : words) {
     int cursor = 0;
     int word_size = word.size();
@@ -52,12 +221,10 @@ Lexer::Lexer(const std::vector<std::string>& words) {
         if (it != _table.end()) {
           _tokens.emplace_back(it->second, it->first);
         } else {
-          _tokens.emplace_back(TokenType::IDENT, std::move(identifier));
           if (right_bound - cursor > 16) {
-            _flag = false;
-            std::cerr << "Line: " << _line << ", Ident out of length: '"
-                      << identifier << "'\n";
+            AddError(DiagnosticCode::IDENT_TOO_LONG, {identifier});
           }
+          _tokens.emplace_back(TokenType::IDENT, std::move(identifier));
         }
         cursor = right_bound;
       } else if (std::isdigit(word[cursor])) {
@@ -66,6 +233,12 @@ Lexer::Lexer(const std::vector<std::string>& words) {
           right_bound++;
         }
         std::string identifier = word.substr(cursor, right_bound - cursor);
+        /* 运行时按 64 位整数计算, 常量必须能放入 int64_t */
+        int64_t value;
+        const auto end = identifier.data() + identifier.size();
+        if (std::from_chars(identifier.data(), end, value).ec != std::errc()) {
+          AddError(DiagnosticCode::NUMBER_TOO_LARGE, {identifier});
+        }
         _tokens.emplace_back(TokenType::NUMBER, std::move(identifier));
         cursor = right_bound;
       } else {
@@ -73,6 +246,8 @@ Lexer::Lexer(const std::vector<std::string>& words) {
           case '\n': {
             _line++;
             _tokens.emplace_back(TokenType::END_OF_LINE, "EOLN");
+            _line_start = _tokens.size();
+            _line_errors.push_back(0);
             break;
           }
           case '=': {
@@ -88,6 +263,12 @@ Lexer::Lexer(const std::vector<std::string>& words) {
             break;
           }
           case '(': {
+            if (cursor + 1 < word_size && word[cursor + 1] == '*') {
+              AddError(DiagnosticCode::UNTERMINATED_COMMENT);
+              _tokens.emplace_back(TokenType::UNKNOWN, "(*");
+              cursor++;
+              break;
+            }
             _tokens.emplace_back(TokenType::L_PAREN, "(");
             break;
           }
@@ -95,6 +276,36 @@ Lexer::Lexer(const std::vector<std::string>& words) {
             _tokens.emplace_back(TokenType::R_PAREN, ")");
             break;
           }
+          case '{': {
+            /* 闭合的注释已在切分单词时跳过 */
+            AddError(DiagnosticCode::UNTERMINATED_COMMENT);
+            _tokens.emplace_back(TokenType::UNKNOWN, "{");
+            break;
+          }
+          case '\'': {
+            /* 字符串不跨行, '' 表示一个单引号 */
+            int right_bound = cursor + 1;
+            bool closed = false;
+            while (!closed && right_bound < word_size) {
+              if (word[right_bound++] != '\'') {
+                continue;
+              }
+              if (right_bound < word_size && word[right_bound] == '\'') {
+                right_bound++;
+              } else {
+                closed = true;
+              }
+            }
+            std::string literal = word.substr(cursor, right_bound - cursor);
+            if (closed) {
+              _tokens.emplace_back(TokenType::STRING, std::move(literal));
+            } else {
+              AddError(DiagnosticCode::UNTERMINATED_STRING, {literal});
+              _tokens.emplace_back(TokenType::UNKNOWN, std::move(literal));
+            }
+            cursor = right_bound - 1;
+            break;
+          }
           case '<': {
             int right_bound = cursor + 1;
             if (right_bound < word_size) {
@@ -128,8 +339,7 @@ Lexer::Lexer(const std::vector<std::string>& words) {
               _tokens.emplace_back(TokenType::ASSIGN, word.substr(cursor, 2));
               cursor++;
             } else {
-              _flag = false;
-              std::cerr << "Line: " << _line << ", Expected '=' after ':'\n";
+              AddError(DiagnosticCode::EXPECTED_EQ_AFTER_COLON);
               _tokens.emplace_back(TokenType::UNKNOWN,
                                    std::string(1, word[cursor]));
             }
@@ -140,11 +350,10 @@ Lexer::Lexer(const std::vector<std::string>& words) {
             break;
           }
           default: {
-            _flag = false;
+            AddError(DiagnosticCode::INVALID_CHARACTER,
+                     {std::string(1, word[cursor])});
             _tokens.emplace_back(TokenType::UNKNOWN,
                                  std::string(1, word[cursor]));
-            std::cerr << "Line: " << _line << ", Invalid character: '"
-                      << word[cursor] << "'\n";
             break;
           }
         }
@@ -155,10 +364,53 @@ Lexer::Lexer(const std::vector<std::string>& words) {
   _tokens.emplace_back(TokenType::END_OF_FILE, "EOF");
 }
 
-auto Lexer::formatPrint(std::ofstream& outputFile) const -> void {
+auto Lexer::AddError(const DiagnosticCode& code,
+                     std::vector<std::string> args) -> void {
+  _errors++;
+  _line_errors.Set(_line_errors.size() - 1, _line_errors.back() + 1);
+  _diagnostics.Report(Severity::ERROR, code, _line, _tokens.size() - _line_start,
+                      std::move(args));
+}
+
+auto Lexer::LineStart(size_t line) const -> size_t {
+  if (line == 0) {
+    return 0;
+  }
+  return _tokens.Find([&](const auto& s) { return s.lines >= line; }) + 1;
+}
+
+auto Lexer::Relex(size_t first_line, size_t removed_lines,
+                  const std::vector<std::string>& words) -> TokenEdit {
+  const size_t inserted_lines =
+      std::count(words.begin(), words.end(), "\n");
+  _diagnostics.RemoveLines(first_line + 1, removed_lines,
+                           long(inserted_lines) - long(removed_lines));
+  Lexer region(words, _diagnostics, first_line + 1);
+  /* 去掉区域末尾的 EOF */
+  std::vector<Token> inserted(region._tokens.begin(),
+                              std::prev(region._tokens.end()));
+
+  /* 只替换涉及的块; 行首位置由换行 token 的计数得出, 不必逐行平移 */
+  const auto first = LineStart(first_line);
+  const auto removed = LineStart(first_line + removed_lines) - first;
+  _tokens.Replace(first, removed, inserted.begin(), inserted.end());
+
+  auto errors = _line_errors.begin() + first_line;
+  for (size_t i = 0; i < removed_lines; i++, errors++) {
+    _errors -= *errors;
+  }
+  _line_errors.Replace(first_line, removed_lines, region._line_errors.begin(),
+                       region._line_errors.begin() + inserted_lines);
+  _errors += region._errors;
+  _line = region._line;
+
+  return TokenEdit{first, removed, std::move(inserted)};
+}
+
+auto Lexer::formatPrint(std::ostream& outputFile) const -> void {
   for (const auto& node : _tokens) {
     outputFile << std::setw(16) << node.getText() << "  " << std::setw(2)
                << int(node.getType()) << " "
-               << TokenTypeToString[node.getType()] << "\n";
+               << TokenTypeToString(node.getType()) << "\n";
   }
 }
\ No newline at end of file
@@ -1,10 +1,16 @@
 #pragma once
 #include <cstdio>
 #include <fstream>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "chunked.hh"
+#include "diagnostics.hh"
+
 enum class TokenType {
   UNKNOWN,
   BEGIN,
@@ -31,10 +37,11 @@ enum class TokenType {
   R_PAREN,
   SEMICOLON,
   END_OF_LINE,
-  END_OF_FILE
+  END_OF_FILE,
+  STRING
 };
 
-extern std::unordered_map<TokenType, std::string> TokenTypeToString;
+auto TokenTypeToString(const TokenType& type) -> const char*;
 
 class Token {
  public:
@@ -48,22 +55,62 @@ class Token {
   std::string _text;
 };
 
+/* 统计换行 token, 用于按行号定位 token */
+struct LineCount {
+  struct Summary {
+    size_t lines = 0;
+    auto operator+=(const Summary& other) -> Summary& {
+      lines += other.lines;
+      return *this;
+    }
+  };
+  static auto Of(const Token& token) -> Summary {
+    return {token.getType() == TokenType::END_OF_LINE};
+  }
+};
+
+using TokenSequence = ChunkedVector<Token, LineCount>;
+
+/* 一次词法增量更新: 用 inserted 替换 [first, first + removed) 的 token */
+struct TokenEdit {
+  size_t first;
+  size_t removed;
+  std::vector<Token> inserted;
+};
+
+/* 按行切分单词, 每行末尾追加 "\n". 注释 { ... } 与 (* ... *) 被跳过,
+ * 其中的换行照常输出; 字符串 '...' 中的空白保留在单词内.
+ * 未闭合的注释以其起始符作为单词留给词法分析报错.
+ * comment_spans 非空时记录跨行注释的首尾行号 (0 起) */
+auto SplitWords(std::string_view source,
+                std::vector<std::pair<size_t, size_t>>* comment_spans =
+                    nullptr) -> std::vector<std::string>;
+auto SplitWords(std::istream& input) -> std::vector<std::string>;
+
 class Lexer {
  public:
-  Lexer(const std::vector<std::string>& words);
-  auto good() const -> const bool { return _flag; }
-  auto formatPrint(std::ofstream& outputFile) const -> void;
-  auto getTokens() const -> const std::vector<Token>& { return _tokens; }
+  Lexer(const std::vector<std::string>& words, Diagnostics& diagnostics,
+        int first_line = 1);
+  auto good() const -> const bool { return _errors == 0; }
+  auto formatPrint(std::ostream& outputFile) const -> void;
+  auto getTokens() const -> const TokenSequence& { return _tokens; }
+  auto getLineCount() const -> size_t { return _tokens.Total().lines; }
+  /* 重新词法分析从 first_line (0 起) 开始的 removed_lines 行 */
+  auto Relex(size_t first_line, size_t removed_lines,
+             const std::vector<std::string>& words) -> TokenEdit;
 
  private:
+  Diagnostics& _diagnostics;
   int _line;
-  bool _flag;
-  std::vector<Token> _tokens;
+  int _errors;
+  TokenSequence _tokens;
+  size_t _line_start;                // 当前行第一个 token 的下标
+  ChunkedVector<int> _line_errors;   // 每行的错误数
+
+  /* 第 line 行 (0 起) 第一个 token 的下标 */
+  auto LineStart(size_t line) const -> size_t;
+  auto AddError(const DiagnosticCode& code,
+                std::vector<std::string> args = {}) -> void;
   /* 用来匹配需要完全匹配的保留字 */
-  std::unordered_map<std::string, TokenType> _table = {
-      {"begin", TokenType::BEGIN},       {"end", TokenType::END},
-      {"integer", TokenType::INTEGER},   {"if", TokenType::IF},
-      {"then", TokenType::THEN},         {"else", TokenType::ELSE},
-      {"function", TokenType::FUNCTION}, {"read", TokenType::READ},
-      {"write", TokenType::WRITE}};
+  static const std::unordered_map<std::string, TokenType> _table;
 };
@@ -1,13 +1,23 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <cstdio>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <ostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "codegen.hh"
+#include "diagnostics.hh"
+#include "engine.hh"
 #include "lexer.hh"
+#include "module.hh"
 #include "parser.hh"
 
 const std::string SOURCE_PATH = "Test/source.pas";
@@ -16,29 +26,166 @@ const std::string DYD_PATH = "Test/source.dyd";
 const std::string DYS_PATH = "Test/source.dys";
 const std::string VAR_PATH = "Test/source.var";
 const std::string PRO_PATH = "Test/source.pro";
+const std::string FOLDED_PATH = "Test/source.folded";
+const std::string PROFILE_PATH = "Test/source.profile.json";
 
-int main() {
-  std::cout.tie(nullptr), std::cerr.tie(nullptr);
-  std::cout << "===========words===========" << std::endl;
-  std::ifstream inputFile(SOURCE_PATH);
-  std::vector<std::string> words;
+/* 解析 --name=N 形式的非负整数选项, 不合法时输出诊断并返回 false */
+template <typename T>
+static auto ParseFlag(const std::string& arg, const std::string& name,
+                      T& value) -> bool {
+  const auto text = arg.substr(name.size());
+  const auto end = text.data() + text.size();
+  const auto [next, error] = std::from_chars(text.data(), end, value);
+  if (text.empty() || error != std::errc() || next != end) {
+    std::cerr << "Invalid value for " << name.substr(0, name.size() - 1)
+              << ": '" << text << "' (expected a non-negative integer)"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/* 读入作业文件: 每行是一个作业的输入整数序列 */
+static auto ReadJobs(const std::string& path, uint64_t max_steps,
+                     size_t max_depth, size_t memo_entries)
+    -> std::vector<Job> {
+  std::ifstream input(path);
+  if (!input) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  std::vector<Job> jobs;
   std::string line;
-  while (std::getline(inputFile, line)) {
-    std::istringstream iss(line);
-    std::string word;
-    while (iss >> word) {
-      words.push_back(std::move(word));
+  while (std::getline(input, line)) {
+    std::istringstream values(line);
+    Job job;
+    job.max_steps = max_steps;
+    job.max_depth = max_depth;
+    job.memo_entries = memo_entries;
+    int64_t value;
+    while (values >> value) {
+      job.inputs.push_back(value);
+    }
+    jobs.push_back(std::move(job));
+  }
+  return jobs;
+}
+
+/* 编译一次, 用多个线程执行作业文件中的每个作业 */
+static auto ExecuteJobs(const Parser& parser, const std::string& path,
+                        size_t threads, uint64_t max_steps, size_t max_depth,
+                        size_t memo_entries, const ProfileMode& profile)
+    -> int {
+  try {
+    CodeGenerator generator(parser);
+    ExecutionEngine engine(generator.getExecutable(), threads, profile);
+    const auto jobs = ReadJobs(path, max_steps, max_depth, memo_entries);
+    const auto results = engine.Run(jobs);
+    for (size_t i = 0; i < results.size(); i++) {
+      std::cout << "job " << i << ":";
+      for (const auto& value : results[i].outputs) {
+        std::cout << " " << value;
+      }
+      if (results[i].status != JobStatus::OK) {
+        std::cout << " (" << JobStatusToString(results[i].status)
+                  << " at line " << results[i].line << ")";
+      }
+      std::cout << std::endl;
+    }
+    const auto& statistics = engine.getStatistics();
+    std::cout << std::fixed << std::setprecision(0)
+              << "jobs: " << statistics.jobs << ", steps: " << statistics.steps
+              << ", jobs/s: " << statistics.jobs / statistics.seconds
+              << ", steps/s: " << statistics.steps / statistics.seconds
+              << std::endl;
+    if (engine.getProfile()) {
+      std::ofstream folded(FOLDED_PATH), json(PROFILE_PATH);
+      engine.getProfile()->WriteFolded(folded);
+      engine.getProfile()->WriteJson(json);
+      std::cout << "Profile written to " << FOLDED_PATH << " and "
+                << PROFILE_PATH << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cout << "Execution aborted: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/* 用法: program [--source=<源文件>] [--diagnostics=text|json|sarif]
+ *               [--max-errors=N]
+ *               [--execute=<作业文件> [--threads=N] [--max-steps=N]
+ *                [--max-depth=N] [--memoize=N] [--profile=count|time]]
+ *       program --build=<清单>   按清单分别编译多个模块 */
+int main(int argc, char* argv[]) {
+  auto format = DiagnosticFormat::TEXT;
+  size_t max_errors = 0;
+  std::string source_path = SOURCE_PATH;
+  std::string jobs_path;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t max_steps = 0;
+  size_t max_depth = 0;
+  size_t memo_entries = 0;
+  auto profile = ProfileMode::OFF;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--diagnostics=json") {
+      format = DiagnosticFormat::JSON;
+    } else if (arg == "--diagnostics=sarif") {
+      format = DiagnosticFormat::SARIF;
+    } else if (arg.rfind("--build=", 0) == 0) {
+      return BuildModules(arg.substr(std::string("--build=").size())) ? 0 : 1;
+    } else if (arg.rfind("--max-errors=", 0) == 0) {
+      if (!ParseFlag(arg, "--max-errors=", max_errors)) {
+        return 1;
+      }
+    } else if (arg.rfind("--source=", 0) == 0) {
+      source_path = arg.substr(std::string("--source=").size());
+    } else if (arg.rfind("--execute=", 0) == 0) {
+      jobs_path = arg.substr(std::string("--execute=").size());
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      if (!ParseFlag(arg, "--threads=", threads)) {
+        return 1;
+      }
+      if (threads == 0) {
+        std::cerr << "--threads must be at least 1" << std::endl;
+        return 1;
+      }
+    } else if (arg.rfind("--max-steps=", 0) == 0) {
+      if (!ParseFlag(arg, "--max-steps=", max_steps)) {
+        return 1;
+      }
+    } else if (arg.rfind("--max-depth=", 0) == 0) {
+      if (!ParseFlag(arg, "--max-depth=", max_depth)) {
+        return 1;
+      }
+    } else if (arg.rfind("--memoize=", 0) == 0) {
+      if (!ParseFlag(arg, "--memoize=", memo_entries)) {
+        return 1;
+      }
+    } else if (arg == "--profile=count") {
+      profile = ProfileMode::COUNT;
+    } else if (arg == "--profile=time") {
+      profile = ProfileMode::TIME;
+    } else if (arg != "--diagnostics=text") {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      return 1;
     }
-    words.push_back("\n");
   }
 
+  std::cout.tie(nullptr), std::cerr.tie(nullptr);
+  std::cout << "===========words===========" << std::endl;
+  std::ifstream inputFile(source_path);
+  std::vector<std::string> words = SplitWords(inputFile);
+
   std::freopen(ERR_PATH.c_str(), "w+", stderr);
 
   std::cout << "===========lexer===========" << std::endl;
   std::ofstream lexerFile(DYD_PATH);
-  std::vector<Token> tokens;
-  Lexer lexer(std::move(words));
+  TokenSequence tokens;
+  Diagnostics diagnostics(max_errors);
+  Lexer lexer(std::move(words), diagnostics);
   if (!lexer.good()) {
+    diagnostics.Emit(std::cerr, format, source_path);
     std::cout << "Compiler aborted due to lexer error. A complete log of "
                  "this run can be found in: "
               << ERR_PATH << std::endl;
@@ -51,7 +198,8 @@ int main() {
   std::ofstream parserDysFile(DYS_PATH);
   std::ofstream parserVarFile(VAR_PATH);
   std::ofstream parserProFile(PRO_PATH);
-  Parser parser(std::move(tokens));
+  Parser parser(std::move(tokens), diagnostics);
+  diagnostics.Emit(std::cerr, format, source_path);
   if (!parser.good()) {
     std::cout << "Compiler aborted due to parser error. A complete log of "
                  "this run can be found in: "
@@ -59,5 +207,10 @@ int main() {
   }
   parser.formatPrint(parserDysFile, parserVarFile, parserProFile);
 
+  if (!jobs_path.empty() && parser.good()) {
+    std::cout << "===========execute===========" << std::endl;
+    return ExecuteJobs(parser, jobs_path, std::max<size_t>(threads, 1),
+                       max_steps, max_depth, memo_entries, profile);
+  }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "module.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "diagnostics.hh"
+#include "lexer.hh"
+
+auto HashBytes(std::string_view bytes, uint64_t hash) -> uint64_t {
+  for (const unsigned char c : bytes) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+ModuleInterface::ModuleInterface(const std::string& path)
+    : _path(path), _data(MAP_FAILED), _size(0) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || ::fstat(fd, &st) < 0) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    throw std::runtime_error("Cannot open interface " + path);
+  }
+  _size = st.st_size;
+  if (_size >= sizeof(InterfaceHeader)) {
+    _data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (_data == MAP_FAILED) {
+    throw std::runtime_error("Invalid interface " + path);
+  }
+
+  _header = static_cast<const InterfaceHeader*>(_data);
+  _functions = reinterpret_cast<const InterfaceFunction*>(_header + 1);
+  _strings = reinterpret_cast<const char*>(_functions + _header->function_count);
+  const auto expected = sizeof(InterfaceHeader) +
+                        size_t(_header->function_count) * sizeof(InterfaceFunction) +
+                        _header->string_size;
+  if (std::memcmp(_header->magic, "UCIF", 4) != 0 ||
+      _header->version != INTERFACE_VERSION || _size != expected ||
+      !ValidFunctions()) {
+    ::munmap(_data, _size);
+    throw std::runtime_error("Invalid interface " + path);
+  }
+}
+
+/* 每个名字都必须落在字符串区内, 且按名字严格递增, Find 的二分查找依赖这一点 */
+auto ModuleInterface::ValidFunctions() const -> bool {
+  for (uint32_t i = 0; i < _header->function_count; i++) {
+    const auto& function = _functions[i];
+    if (uint64_t(function.name_offset) + function.name_length >
+        _header->string_size) {
+      return false;
+    }
+    if (i > 0 && !(getName(_functions[i - 1]) < getName(function))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ModuleInterface::~ModuleInterface() { ::munmap(_data, _size); }
+
+auto ModuleInterface::getName(const InterfaceFunction& function) const
+    -> std::string_view {
+  return std::string_view(_strings + function.name_offset, function.name_length);
+}
+
+auto ModuleInterface::Find(std::string_view name) const
+    -> const InterfaceFunction* {
+  const auto end = _functions + _header->function_count;
+  const auto it = std::lower_bound(
+      _functions, end, name,
+      [&](const auto& f, std::string_view n) { return getName(f) < n; });
+  if (it != end && getName(*it) == name) {
+    return it;
+  }
+  return nullptr;
+}
+
+auto BuildInterface(const Parser& parser, uint64_t source_hash,
+                    uint64_t imports_hash) -> std::string {
+  std::vector<std::shared_ptr<Procedure>> exported;
+  for (const auto& pro : parser.getProcedures()) {
+    if (pro->_level == 1) {
+      exported.push_back(pro);
+    }
+  }
+  std::sort(exported.begin(), exported.end(),
+            [](const auto& a, const auto& b) { return a->_name < b->_name; });
+
+  std::vector<InterfaceFunction> functions;
+  std::string strings;
+  for (const auto& pro : exported) {
+    InterfaceFunction function{uint32_t(strings.size()),
+                               uint32_t(pro->_name.size()),
+                               uint32_t(pro->_level), uint8_t(pro->_type),
+                               uint8_t(Type::INT), 0};
+    for (const auto& var : parser.getVariables()) {
+      if (var->_kind == 1 && var->_procedure == pro) {
+        function.parameter_type = uint8_t(var->_type);
+        function.parameter_count++;
+      }
+    }
+    functions.push_back(function);
+    strings += pro->_name;
+  }
+
+  const std::string_view body(reinterpret_cast<const char*>(functions.data()),
+                              functions.size() * sizeof(InterfaceFunction));
+  InterfaceHeader header{{'U', 'C', 'I', 'F'},
+                         INTERFACE_VERSION,
+                         source_hash,
+                         imports_hash,
+                         HashBytes(strings, HashBytes(body)),
+                         uint32_t(functions.size()),
+                         uint32_t(strings.size())};
+  std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+  bytes.append(body);
+  bytes.append(strings);
+  return bytes;
+}
+
+/* 先写到同目录的临时文件再 rename 覆盖, 正在 mmap 旧接口的导入方
+ * 仍然看到完整的旧文件, 不会因文件被截断而收到 SIGBUS */
+static auto WriteInterface(const std::string& path, const std::string& bytes)
+    -> bool {
+  const auto temp = path + ".tmp." + std::to_string(::getpid());
+  {
+    std::ofstream output(temp, std::ios::binary | std::ios::trunc);
+    output.write(bytes.data(), bytes.size());
+    if (!output.flush()) {
+      std::remove(temp.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+static auto Stem(const std::string& path) -> std::string {
+  const auto slash = path.rfind('/');
+  const auto name = slash == std::string::npos ? 0 : slash + 1;
+  const auto dot = path.rfind('.');
+  /* 只去掉文件名中的扩展名, 目录名中的点与 ".pas" 这样的隐藏文件名保留 */
+  if (dot == std::string::npos || dot <= name) {
+    return path;
+  }
+  return path.substr(0, dot);
+}
+
+/* 编译一个模块, 输出与主程序相同的各个文件以及接口文件 */
+static auto CompileModule(const std::string& path, const std::string& source,
+                          uint64_t source_hash, uint64_t imports_hash,
+                          const std::vector<const ModuleInterface*>& imports)
+    -> bool {
+  const auto stem = Stem(path);
+  Diagnostics diagnostics;
+  Lexer lexer(SplitWords(source), diagnostics);
+  bool good = lexer.good();
+  if (good) {
+    std::ofstream lexerFile(stem + ".dyd");
+    lexer.formatPrint(lexerFile);
+    Parser parser(lexer.getTokens(), diagnostics, imports);
+    std::ofstream dysFile(stem + ".dys"), varFile(stem + ".var"),
+        proFile(stem + ".pro");
+    parser.formatPrint(dysFile, varFile, proFile);
+    good = parser.good();
+    if (good) {
+      const auto bytes = BuildInterface(parser, source_hash, imports_hash);
+      if (!WriteInterface(stem + ".ifc", bytes)) {
+        std::cerr << "Cannot write interface " << stem << ".ifc" << std::endl;
+        good = false;
+      }
+    }
+  }
+  std::ofstream errFile(stem + ".err");
+  diagnostics.Emit(errFile, DiagnosticFormat::TEXT, path);
+  return good;
+}
+
+auto BuildModules(const std::string& manifest_path) -> bool {
+  std::ifstream manifest(manifest_path);
+  if (!manifest) {
+    std::cerr << "Cannot open manifest " << manifest_path << std::endl;
+    return false;
+  }
+
+  std::map<std::string, std::unique_ptr<ModuleInterface>> interfaces;
+  std::string line;
+  while (std::getline(manifest, line)) {
+    const auto colon = line.find(':');
+    std::istringstream module_name(line.substr(0, colon));
+    std::string path;
+    if (!(module_name >> path)) {
+      continue;
+    }
+
+    /* 依赖的接口按清单顺序组合成 imports_hash */
+    std::vector<const ModuleInterface*> imports;
+    uint64_t imports_hash = HashBytes("");
+    std::istringstream dependencies(
+        colon == std::string::npos ? "" : line.substr(colon + 1));
+    std::string dependency;
+    while (dependencies >> dependency) {
+      const auto it = interfaces.find(dependency);
+      if (it == interfaces.end() || !it->second) {
+        std::cerr << path << ": dependency " << dependency
+                  << " has not been built" << std::endl;
+        return false;
+      }
+      imports.push_back(it->second.get());
+      const auto hash = it->second->getHeader().interface_hash;
+      imports_hash = HashBytes(
+          std::string_view(reinterpret_cast<const char*>(&hash), sizeof(hash)),
+          imports_hash);
+    }
+
+    std::ifstream sourceFile(path);
+    if (!sourceFile) {
+      std::cerr << "Cannot open " << path << std::endl;
+      return false;
+    }
+    std::stringstream buffer;
+    buffer << sourceFile.rdbuf();
+    const auto source = buffer.str();
+    const auto source_hash = HashBytes(source);
+    const auto interface_path = Stem(path) + ".ifc";
+
+    std::unique_ptr<ModuleInterface> interface;
+    try {
+      interface = std::make_unique<ModuleInterface>(interface_path);
+    } catch (const std::runtime_error& e) {
+    }
+    if (interface && interface->getHeader().source_hash == source_hash &&
+        interface->getHeader().imports_hash == imports_hash) {
+      std::cout << "Up to date: " << path << std::endl;
+    } else {
+      interface.reset();
+      std::cout << "Compiling: " << path << std::endl;
+      if (!CompileModule(path, source, source_hash, imports_hash,
+                         imports)) {
+        std::cerr << "Compiler aborted due to errors in " << path
+                  << ". A complete log can be found in: " << Stem(path)
+                  << ".err" << std::endl;
+        return false;
+      }
+      interface = std::make_unique<ModuleInterface>(interface_path);
+    }
+    interfaces[path] = std::move(interface);
+  }
+  return true;
+}
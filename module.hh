@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.hh"
+
+/* 模块接口文件 (.ifc): 记录模块导出的函数, 导入方直接 mmap, 无需重新分析源码.
+ * 布局为 InterfaceHeader, 按名字排序的 InterfaceFunction 数组, 名字字符串区 */
+
+const uint32_t INTERFACE_VERSION = 1;
+
+struct InterfaceHeader {
+  char magic[4];            // "UCIF"
+  uint32_t version;
+  uint64_t source_hash;     // 生成该接口的源码
+  uint64_t imports_hash;    // 编译时导入的各接口的 interface_hash
+  uint64_t interface_hash;  // 函数数组与字符串区的哈希, 只随导出内容变化
+  uint32_t function_count;
+  uint32_t string_size;
+};
+
+struct InterfaceFunction {
+  uint32_t name_offset;
+  uint32_t name_length;
+  uint32_t level;
+  uint8_t return_type;
+  uint8_t parameter_type;
+  uint16_t parameter_count;  // 文法中每个函数恰有一个参数
+};
+
+auto HashBytes(std::string_view bytes, uint64_t hash = 0xcbf29ce484222325ULL)
+    -> uint64_t;
+
+/* 只读映射一个接口文件, 文件不存在或格式不对 (包括名字越出字符串区) 时
+ * 抛出 std::runtime_error, 调用方据此重新编译该模块 */
+class ModuleInterface {
+ public:
+  ModuleInterface(const std::string& path);
+  ~ModuleInterface();
+  ModuleInterface(const ModuleInterface&) = delete;
+  auto operator=(const ModuleInterface&) -> ModuleInterface& = delete;
+
+  auto getHeader() const -> const InterfaceHeader& { return *_header; }
+  auto getPath() const -> const std::string& { return _path; }
+  auto getName(const InterfaceFunction& function) const -> std::string_view;
+  auto Find(std::string_view name) const -> const InterfaceFunction*;
+
+ private:
+  std::string _path;
+  void* _data;
+  size_t _size;
+  const InterfaceHeader* _header;
+  const InterfaceFunction* _functions;
+  const char* _strings;
+
+  auto ValidFunctions() const -> bool;
+};
+
+/* 由分析结果生成接口文件内容, 导出主程序中直接声明的函数 */
+auto BuildInterface(const Parser& parser, uint64_t source_hash,
+                    uint64_t imports_hash) -> std::string;
+
+/* 按清单构建多个模块, 清单每行为 "模块.pas: 依赖1.pas 依赖2.pas",
+ * 依赖必须出现在更前面的行中. 源码与所导入接口的导出内容都没有变化的模块不会重新编译.
+ * 返回是否全部编译成功 */
+auto BuildModules(const std::string& manifest_path) -> bool;
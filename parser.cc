@@ -2,30 +2,267 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <iterator>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <utility>
 
 #include "lexer.hh"
-
-Parser::Parser(const std::vector<Token>& tokens)
-    : _flag(true),
+#include "module.hh"
+
+Parser::Parser(const TokenSequence& tokens, Diagnostics& diagnostics,
+               const std::vector<const ModuleInterface*>& imports)
+    : _diagnostics(diagnostics),
+      _first_diagnostic(diagnostics.size()),
+      _flag(true),
+      _errors(0),
       _line(1),
       _idx(0),
       _current_address(0),
-      _tokens(std::move(tokens)),
-      _cursor(_tokens.begin()) {
+      _tokens(tokens),
+      _cursor(_tokens.begin()),
+      _imports(imports) {
   try {
     Program();
   } catch (const std::exception& e) {
   }
 }
 
-auto Parser::AddError(const std::string& msg) -> void {
+auto Parser::Update(const TokenEdit& edit) -> void {
+  const auto cursor = _cursor - _tokens.begin();
+  const auto delta = long(edit.inserted.size()) - long(edit.removed);
+  _tokens.Replace(edit.first, edit.removed, edit.inserted.begin(),
+                  edit.inserted.end());
+
+  const auto next = _checkpoints.Find(
+      [&](const Position& p) { return p.token >= edit.first; });
+  if (next == 0) {
+    /* 编辑位于第一条语句之前, 整体重新分析 */
+    _flag = true;
+    _errors = 0;
+    _line = 1;
+    _idx = 0;
+    _current_address = 0;
+    _results.clear();
+    _variables.clear();
+    _procedures.clear();
+    _checkpoints.clear();
+    _diagnostics.Truncate(_first_diagnostic);
+    _callStack = {};
+    _scope_starts = {};
+    _cursor = _tokens.begin();
+    try {
+      Program();
+    } catch (const std::exception& e) {
+    }
+    return;
+  }
+
+  const auto base = _checkpoints[next - 1];
+  const auto position = _checkpoints.Prefix(next);
+  const auto main = _procedures.front();
+  _tail = std::make_unique<Tail>();
+  _tail->base = base;
+  _tail->base_position = position;
+  _tail->edit_end = edit.first + edit.inserted.size();
+  _tail->delta = delta;
+  _tail->results = std::move(_results);
+  _results.clear();
+  _tail->variables = _variables.Split(base.variable);
+  _tail->procedures = _procedures.Split(base.procedure);
+  _tail->checkpoints = _checkpoints.Split(next);
+  _tail->diagnostics = _diagnostics.Truncate(position.diagnostic);
+  _tail->cursor = cursor;
+  _tail->line = _line;
+  _tail->idx = _idx;
+  _tail->address = _current_address;
+  _tail->errors = _errors;
+  _tail->first_var_address = main->_first_var_address;
+  _tail->last_val_address = main->_last_val_address;
+
+  _errors = position.errors;
+  _flag = _errors == 0;
+  _line = position.line;
+  _idx = base.idx;
+  _current_address = base.address;
+  main->_first_var_address = base.first_var_address;
+  main->_last_val_address = base.last_val_address;
+  /* main 的名字从序列开头登记 */
+  _callStack = {main};
+  _scope_starts = {{0, 1}};
+  _cursor = _tokens.begin() + position.token;
+
+  try {
+    Resume(base.is_execution);
+  } catch (const Resynchronized&) {
+  } catch (const std::exception& e) {
+  }
+  if (_tail) {
+    DropTail();
+  }
+}
+
+auto Parser::SaveCheckpoint(bool is_execution) -> void {
+  if (_callStack.size() != 1) {
+    return;
+  }
+  const auto& main = _callStack.back();
+  const Position position{size_t(_cursor - _tokens.begin()), ResultCount(),
+                          _line, _errors, _diagnostics.size()};
+  const auto last = _checkpoints.Total();
+  const Checkpoint checkpoint{is_execution,
+                              {position.token - last.token,
+                               position.result - last.result,
+                               position.line - last.line,
+                               position.errors - last.errors,
+                               position.diagnostic - last.diagnostic},
+                              _variables.size(),
+                              _procedures.size(),
+                              _idx,
+                              _current_address,
+                              main->_first_var_address,
+                              main->_last_val_address};
+  if (_tail && TrySplice(position, checkpoint)) {
+    throw Resynchronized();
+  }
+  _checkpoints.push_back(checkpoint);
+}
+
+/* 在编辑区域之后遇到与旧结果一致的检查点时, 直接接上旧的分析结果 */
+auto Parser::TrySplice(const Position& position, const Checkpoint& checkpoint)
+    -> bool {
+  auto& tail = *_tail;
+  if (position.token < tail.edit_end) {
+    return false;
+  }
+  const auto& base = tail.base;
+  auto old = tail.base_position;
+  const auto old_token = size_t(long(position.token) - tail.delta);
+  const auto match = tail.checkpoints.Find([&](const Position& p) {
+    return old.token + p.token >= old_token;
+  });
+  if (match == tail.checkpoints.size()) {
+    return false;
+  }
+  old += tail.checkpoints.Prefix(match + 1);
+  const auto& it = tail.checkpoints[match];
+  if (old.token != old_token || it.is_execution != checkpoint.is_execution) {
+    return false;
+  }
+
+  /* 重新分析区域内的符号必须与旧结果完全一致, 否则之后的地址与查找都会变化 */
+  const auto same_variable = [](const auto& a, const auto& b) {
+    return a->_name == b->_name && a->_kind == b->_kind &&
+           a->_type == b->_type && a->_level == b->_level &&
+           a->_is_declared == b->_is_declared &&
+           a->_procedure->_name == b->_procedure->_name;
+  };
+  const auto same_procedure = [](const auto& a, const auto& b) {
+    return a->_name == b->_name && a->_type == b->_type &&
+           a->_level == b->_level;
+  };
+  if (checkpoint.address != it.address ||
+      !std::equal(_variables.begin() + base.variable, _variables.end(),
+                  tail.variables.begin(),
+                  tail.variables.begin() + (it.variable - base.variable),
+                  same_variable) ||
+      !std::equal(_procedures.begin() + base.procedure, _procedures.end(),
+                  tail.procedures.begin(),
+                  tail.procedures.begin() + (it.procedure - base.procedure),
+                  same_procedure)) {
+    DropTail();
+    return false;
+  }
+
+  /* 旧结果从匹配的检查点起整块接回; 之后的检查点记录的是相对位移, 原样保留 */
+  const auto line_shift = position.line - old.line;
+  const auto error_shift = position.errors - old.errors;
+  tail.results.Replace(tail.base_position.result,
+                       old.result - tail.base_position.result,
+                       _results.begin(), _results.end());
+  _results = std::move(tail.results);
+  _variables.Append(tail.variables.Split(it.variable - base.variable));
+  _procedures.Append(tail.procedures.Split(it.procedure - base.procedure));
+  auto checkpoints = tail.checkpoints.Split(match + 1);
+
+  /* 旧的诊断按行号平移后重新加入; 被去重丢弃时所属检查点的诊断位移减一 */
+  size_t kept = 0;
+  for (auto diagnostic = tail.diagnostics.begin() +
+                         (old.diagnostic - tail.base_position.diagnostic);
+       diagnostic != tail.diagnostics.end(); diagnostic++) {
+    diagnostic->_line += line_shift;
+    if (_diagnostics.Add(std::move(*diagnostic))) {
+      kept++;
+      continue;
+    }
+    const auto owner = checkpoints.Find(
+        [&](const Position& p) { return p.diagnostic > kept; });
+    if (owner < checkpoints.size()) {
+      auto dropped = checkpoints[owner];
+      dropped.offset.diagnostic--;
+      checkpoints.Set(owner, dropped);
+    }
+  }
+  _checkpoints.push_back(checkpoint);
+  _checkpoints.Append(std::move(checkpoints));
+
+  const auto& main = _procedures.front();
+  main->_first_var_address = tail.first_var_address;
+  main->_last_val_address = tail.last_val_address;
+  _current_address = tail.address;
+  _errors = tail.errors + error_shift;
+  _flag = _errors == 0;
+  _line = tail.line + line_shift;
+  _idx = tail.idx;
+  _cursor = _tokens.begin() + (tail.cursor + tail.delta);
+  _tail.reset();
+  return true;
+}
+
+/* 放弃重新同步: 重新分析的区域接在旧结果的 base 之前, 之后照常分析到末尾 */
+auto Parser::DropTail() -> void {
+  auto results = std::move(_tail->results);
+  results.Truncate(_tail->base_position.result);
+  results.Append(std::move(_results));
+  _results = std::move(results);
+  _tail.reset();
+}
+
+auto Parser::ResultCount() const -> size_t {
+  return (_tail ? _tail->base_position.result : 0) + _results.size();
+}
+
+auto Parser::LastResult() const -> const Token& {
+  if (_tail && _results.empty()) {
+    return _tail->results[_tail->base_position.result - 1];
+  }
+  return _results.back();
+}
+
+auto Parser::Resume(bool is_execution) -> void {
+  if (!is_execution) {
+    Declaration();
+    Declarations_();
+    Executions();
+  } else {
+    Execution();
+    Executions_();
+  }
+  Match(TokenType::END);
+  LeaveScope();
+  Match(TokenType::END_OF_FILE);
+}
+
+auto Parser::AddError(const DiagnosticCode& code,
+                      std::vector<std::string> args) -> void {
   _flag = false;
-  std::cerr << "Error at line " << _line << ", index " << _idx << ": " << msg
-            << std::endl;
+  _errors++;
+  _diagnostics.Report(Severity::ERROR, code, _line, _idx, std::move(args));
+  if (_diagnostics.full()) {
+    _diagnostics.Stop(_line, _idx);
+    throw std::runtime_error("Too many errors");
+  }
 }
 
 auto Parser::SkipEndOfLine() -> void {
@@ -38,18 +275,23 @@ auto Parser::SkipEndOfLine() -> void {
   }
 }
 
-auto Parser::Match(const TokenType& type,
-                   const std::string& err_message) -> void {
+auto Parser::Match(const TokenType& type, const DiagnosticCode& code)
+    -> void {
   SkipEndOfLine();
   if (_cursor == _tokens.end()) {
-    AddError(err_message.empty() ? "Missing symbol" + TokenTypeToString[type]
-                                 : err_message);
+    if (code == DiagnosticCode::EXPECTED_TOKEN) {
+      AddError(DiagnosticCode::MISSING_SYMBOL, {TokenTypeToString(type)});
+    } else {
+      AddError(code);
+    }
     return;
   }
   if (_cursor->getType() != type) {
-    AddError(err_message.empty() ? "Expected " + TokenTypeToString[type] +
-                                       ", but got " + _cursor->getText()
-                                 : err_message);
+    if (code == DiagnosticCode::EXPECTED_TOKEN) {
+      AddError(code, {TokenTypeToString(type), _cursor->getText()});
+    } else {
+      AddError(code);
+    }
     return;
   }
   _results.emplace_back(*_cursor);
@@ -69,16 +311,18 @@ auto Parser::SubProgram() -> void {
   Declarations();
   Executions();
   Match(TokenType::END);
-  _callStack.pop();
+  LeaveScope();
 }
 
 auto Parser::Declarations() -> void {
+  SaveCheckpoint(false);
   Declaration();
   Declarations_();
 }
 
 auto Parser::Declarations_() -> void {
   if (_cursor->getType() == TokenType::INTEGER) {
+    SaveCheckpoint(false);
     Declaration();
     Declarations_();
   }
@@ -101,21 +345,33 @@ auto Parser::Declaration_() -> void {
       break;
     }
     default: {
-      AddError("Invalid variable name " + _cursor->getText());
+      AddError(DiagnosticCode::INVALID_VARIABLE_NAME, {_cursor->getText()});
       break;
     }
   }
 }
 
-auto Parser::VariableDeclaration() -> void {
+/* 匹配一个标识符并返回它的文本. Match 之后会跳过行尾,
+ * 标识符位于行末时 LastResult 是换行 token, 不能用来取名字 */
+auto Parser::MatchIdent() -> std::string {
+  SkipEndOfLine();
+  if (_cursor == _tokens.end() || _cursor->getType() != TokenType::IDENT) {
+    Match(TokenType::IDENT);
+    return LastResult().getText();
+  }
+  auto name = _cursor->getText();
   Match(TokenType::IDENT);
-  registerVariable(_results.back().getText());
+  return name;
+}
+
+auto Parser::VariableDeclaration() -> void {
+  registerVariable(MatchIdent());
 }
 
 auto Parser::Variable() -> void {
-  Match(TokenType::IDENT);
-  if (!findVariable(_results.back().getText())) {
-    registerVariable(_results.back().getText());
+  const auto name = MatchIdent();
+  if (!findVariable(name)) {
+    registerVariable(name);
   }
 }
 
@@ -124,28 +380,25 @@ auto Parser::ProcedureDeclaration() -> void {
   ProcedureNameDeclaration();
   Match(TokenType::L_PAREN);
   ParameterDeclaration();
-  Match(TokenType::R_PAREN, "Unmatched '(', expected ')'");
+  Match(TokenType::R_PAREN, DiagnosticCode::UNMATCHED_PAREN);
   Match(TokenType::SEMICOLON);
   ProcedureBody();
 }
 
 auto Parser::ProcedureNameDeclaration() -> void {
-  Match(TokenType::IDENT);
-  registerProcedure(_results.back().getText());
+  registerProcedure(MatchIdent());
 }
 
 auto Parser::ProcedureName() -> void {
-  Match(TokenType::IDENT);
-  if (!findProcedure(_results.back().getText())) {
-    AddError("Undefined procedure '" + _results.back().getText() + "'");
-    throw std::runtime_error("Undefined procedure '" +
-                             _results.back().getText() + "'");
+  const auto name = MatchIdent();
+  if (!findProcedure(name)) {
+    AddError(DiagnosticCode::UNDEFINED_PROCEDURE, {name});
+    throw std::runtime_error("Undefined procedure '" + name + "'");
   }
 }
 
 auto Parser::ParameterDeclaration() -> void {
-  Match(TokenType::IDENT);
-  registerParameter(_results.back().getText());
+  registerParameter(MatchIdent());
 }
 
 auto Parser::ProcedureBody() -> void {
@@ -153,10 +406,11 @@ auto Parser::ProcedureBody() -> void {
   Declarations();
   Executions();
   Match(TokenType::END);
-  _callStack.pop();
+  LeaveScope();
 }
 
 auto Parser::Executions() -> void {
+  SaveCheckpoint(true);
   Execution();
   Executions_();
 }
@@ -164,6 +418,7 @@ auto Parser::Executions() -> void {
 auto Parser::Executions_() -> void {
   if (_cursor->getType() == TokenType::SEMICOLON) {
     Match(TokenType::SEMICOLON);
+    SaveCheckpoint(true);
     Execution();
     Executions_();
   }
@@ -188,8 +443,8 @@ auto Parser::Execution() -> void {
       break;
     }
     default: {
-      AddError("Exection cannot begin with " + _cursor->getText());
-      throw std::runtime_error("Exection cannot begin with " +
+      AddError(DiagnosticCode::INVALID_EXECUTION, {_cursor->getText()});
+      throw std::runtime_error("Execution cannot begin with " +
                                _cursor->getText());
     }
   }
@@ -199,14 +454,18 @@ auto Parser::Read() -> void {
   Match(TokenType::READ);
   Match(TokenType::L_PAREN);
   Variable();
-  Match(TokenType::R_PAREN, "Unmatched '(', expected ')'");
+  Match(TokenType::R_PAREN, DiagnosticCode::UNMATCHED_PAREN);
 }
 
 auto Parser::Write() -> void {
   Match(TokenType::WRITE);
   Match(TokenType::L_PAREN);
-  Variable();
-  Match(TokenType::R_PAREN, "Unmatched '(', expected ')'");
+  if (_cursor != _tokens.end() && _cursor->getType() == TokenType::STRING) {
+    Match(TokenType::STRING);
+  } else {
+    Variable();
+  }
+  Match(TokenType::R_PAREN, DiagnosticCode::UNMATCHED_PAREN);
 }
 
 auto Parser::Assign() -> void {
@@ -215,7 +474,7 @@ auto Parser::Assign() -> void {
   } else if (findProcedure(_cursor->getText())) {
     ProcedureName();
   } else {
-    AddError("Undefined variable or procedure" + _cursor->getText());
+    AddError(DiagnosticCode::UNDEFINED_SYMBOL, {_cursor->getText()});
   }
   Match(TokenType::ASSIGN);
   ArithmeticExpression();
@@ -262,14 +521,13 @@ auto Parser::Factor() -> void {
         ProcedureCall();
         return;
       }
-      AddError("Undefined variable or procedure " + _cursor->getText());
+      AddError(DiagnosticCode::UNDEFINED_SYMBOL, {_cursor->getText()});
       throw std::runtime_error("Undefined variable or procedure " +
                                _cursor->getText());
       break;
     }
     default: {
-      AddError("Expect variable, procedure or constant, but got " +
-               _cursor->getText());
+      AddError(DiagnosticCode::EXPECTED_FACTOR, {_cursor->getText()});
       throw std::runtime_error(
           "Expect variable, procedure or constant, but got " +
           _cursor->getText());
@@ -282,7 +540,7 @@ auto Parser::ProcedureCall() -> void {
   ProcedureName();
   Match(TokenType::L_PAREN);
   ArithmeticExpression();
-  Match(TokenType::R_PAREN, "Unmatched '(', expected ')'");
+  Match(TokenType::R_PAREN, DiagnosticCode::UNMATCHED_PAREN);
 }
 
 auto Parser::Condition() -> void {
@@ -327,7 +585,7 @@ auto Parser::Operator() -> void {
       break;
     }
     default: {
-      AddError("'" + _cursor->getText() + "' is not an operator");
+      AddError(DiagnosticCode::NOT_AN_OPERATOR, {_cursor->getText()});
       break;
     }
   }
@@ -341,9 +599,9 @@ auto Parser::registerVariable(const std::string& name) -> void {
   };
 
   if (findDuplicateVariable(name)) {
-    AddError("Parameter '" + name + "' has already been declared");
+    AddError(DiagnosticCode::DUPLICATE_VARIABLE, {name});
   }
-  auto ptr = std::make_shared<class Variable>(name, _callStack.top(), 0,
+  auto ptr = std::make_shared<class Variable>(name, _callStack.back(), 0,
                                               Type::INT, _callStack.size(),
                                               ++_current_address, true);
   _variables.emplace_back(ptr);
@@ -351,33 +609,42 @@ auto Parser::registerVariable(const std::string& name) -> void {
 }
 
 auto Parser::findDuplicateVariable(const std::string& name) -> bool {
-  auto it =
-      std::find_if(_variables.begin(), _variables.end(), [&](const auto& v) {
-        return v->_name == name && v->_procedure == _callStack.top();
+  auto it = std::find_if(
+      _variables.begin() + _scope_starts.back().first, _variables.end(),
+      [&](const auto& v) {
+        return v->_name == name && v->_procedure == _callStack.back();
       });
   return it != _variables.end();
 }
 
+/* 沿外层函数链由内向外查找, 每一层只看该层登记名字的区间 */
 auto Parser::findVariable(const std::string& name)
     -> std::shared_ptr<class Variable> {
-  auto it =
-      std::find_if(_variables.begin(), _variables.end(), [&](const auto& v) {
-        return v->_name == name && v->_level <= _callStack.size();
-      });
-  if (it != _variables.end()) {
+  for (auto scope = _callStack.size(); scope-- > 0;) {
+    const auto first = _variables.begin() + _scope_starts[scope].first;
+    const auto last = scope + 1 < _callStack.size()
+                          ? _variables.begin() + _scope_starts[scope + 1].first
+                          : _variables.end();
+    const auto it = std::find_if(first, last, [&](const auto& v) {
+      return v->_name == name && v->_procedure == _callStack[scope];
+    });
+    if (it == last) {
+      continue;
+    }
     if ((*it)->_is_declared) {
       return *it;
     }
-    AddError("Variable '" + name + "' has not been declared");
+    AddError(DiagnosticCode::UNDECLARED_VARIABLE, {name});
+    return nullptr;
   }
   return nullptr;
 }
 
 auto Parser::registerParameter(const std::string& name) -> void {
   if (findDuplicateParameter(name)) {
-    AddError("Parameter '" + name + "' has already been declared");
+    AddError(DiagnosticCode::DUPLICATE_PARAMETER, {name});
   }
-  auto ptr = std::make_shared<class Variable>(name, _callStack.top(), 1,
+  auto ptr = std::make_shared<class Variable>(name, _callStack.back(), 1,
                                               Type::INT, _callStack.size(),
                                               ++_current_address, false);
   _variables.emplace_back(ptr);
@@ -385,20 +652,22 @@ auto Parser::registerParameter(const std::string& name) -> void {
 }
 
 auto Parser::findDuplicateParameter(const std::string& name) -> bool {
-  auto it =
-      std::find_if(_variables.begin(), _variables.end(), [&](const auto& p) {
+  auto it = std::find_if(
+      _variables.begin() + _scope_starts.back().first, _variables.end(),
+      [&](const auto& p) {
         return p->_name == name && p->_kind == 1 &&
-               p->_procedure == _callStack.top();
+               p->_procedure == _callStack.back();
       });
   return it != _variables.end();
 }
 
 auto Parser::findParameter(const std::string& name)
     -> std::shared_ptr<class Variable> {
-  auto it =
-      std::find_if(_variables.begin(), _variables.end(), [&](const auto& p) {
+  auto it = std::find_if(
+      _variables.begin() + _scope_starts.back().first, _variables.end(),
+      [&](const auto& p) {
         return p->_name == name && p->_kind == 1 &&
-               p->_level <= _callStack.size();
+               p->_procedure == _callStack.back();
       });
   if (it != _variables.end()) {
     return *it;
@@ -408,50 +677,103 @@ auto Parser::findParameter(const std::string& name)
 
 auto Parser::registerProcedure(const std::string& name) -> void {
   if (findDuplicateProcedure(name)) {
-    AddError("Procedure '" + name + "' has already been declared");
+    AddError(DiagnosticCode::DUPLICATE_PROCEDURE, {name});
   }
   auto ptr =
       std::make_shared<class Procedure>(name, Type::INT, _callStack.size());
+  if (!_callStack.empty()) {
+    ptr->_parent = _callStack.back();
+  }
   _procedures.emplace_back(ptr);
-  _callStack.push(ptr);
+  EnterScope(ptr);
+}
+
+/* 进入刚登记的函数, 记下此后登记的名字的起点, 见 _scope_starts */
+auto Parser::EnterScope(const std::shared_ptr<Procedure>& procedure) -> void {
+  _callStack.push_back(procedure);
+  _scope_starts.emplace_back(_variables.size(), _procedures.size());
+}
+
+auto Parser::LeaveScope() -> void {
+  _callStack.pop_back();
+  _scope_starts.pop_back();
 }
 
 auto Parser::findDuplicateProcedure(const std::string& name) -> bool {
-  auto it =
-      std::find_if(_procedures.begin(), _procedures.end(), [&](const auto& p) {
-        return p->_name == name && p->_level == _callStack.size();
+  if (_callStack.empty()) {
+    return false;
+  }
+  auto it = std::find_if(
+      _procedures.begin() + _scope_starts.back().second, _procedures.end(),
+      [&](const auto& p) {
+        return p->_name == name && p->_parent == _callStack.back();
       });
   return it != _procedures.end();
 }
 
+/* 可见的是直接说明在外层函数链上某个函数中的函数, 同样由内向外查找 */
 auto Parser::findProcedure(const std::string& name)
     -> std::shared_ptr<class Procedure> {
+  for (auto scope = _callStack.size(); scope-- > 0;) {
+    const auto first = _procedures.begin() + _scope_starts[scope].second;
+    const auto last = scope + 1 < _callStack.size()
+                          ? _procedures.begin() + _scope_starts[scope + 1].second
+                          : _procedures.end();
+    const auto it = std::find_if(first, last, [&](const auto& p) {
+      return p->_name == name && p->_parent == _callStack[scope];
+    });
+    if (it != last) {
+      return *it;
+    }
+  }
+  return findImportedProcedure(name);
+}
+
+auto Parser::findImportedProcedure(const std::string& name)
+    -> std::shared_ptr<class Procedure> {
   auto it =
-      std::find_if(_procedures.begin(), _procedures.end(), [&](const auto& p) {
-        return p->_name == name && p->_level <= _callStack.size();
-      });
-  if (it != _procedures.end()) {
+      std::find_if(_imported.begin(), _imported.end(),
+                   [&](const auto& p) { return p->_name == name; });
+  if (it != _imported.end()) {
     return *it;
   }
+  for (const auto* module : _imports) {
+    const auto* function = module->Find(name);
+    if (function) {
+      auto ptr = std::make_shared<class Procedure>(
+          name, Type(function->return_type), function->level);
+      _imported.emplace_back(ptr);
+      return ptr;
+    }
+  }
   return nullptr;
 }
 
 auto Parser::updateProcedureVariableAddresses() -> void {
-  auto p = _callStack.top();
+  auto p = _callStack.back();
   if (p->_first_var_address == -1) {
     p->_first_var_address = _current_address;
   }
   p->_last_val_address = _current_address;
 }
 
-std::unordered_map<Type, std::string> TypeToString = {
-    {Type::VOID, "VOID"}, {Type::INT, "INTEGER"}, {Type::STRING, "STRING"}};
+auto TypeToString(const Type& type) -> const char* {
+  switch (type) {
+    case Type::VOID:
+      return "VOID";
+    case Type::INT:
+      return "INTEGER";
+    case Type::STRING:
+      return "STRING";
+  }
+  return "VOID";
+}
 
-auto Parser::formatPrint(std::ofstream& dysFile, std::ofstream& varFile,
-                         std::ofstream& proFile) const -> void {
+auto Parser::formatPrint(std::ostream& dysFile, std::ostream& varFile,
+                         std::ostream& proFile) const -> void {
   for (const auto& node : _results) {
     dysFile << std::setw(16) << node.getText() << "  " << std::setw(2)
-            << int(node.getType()) << " " << TokenTypeToString[node.getType()]
+            << int(node.getType()) << " " << TokenTypeToString(node.getType())
             << "\n";
   }
 
@@ -459,7 +781,7 @@ auto Parser::formatPrint(std::ofstream& dysFile, std::ofstream& varFile,
   for (const auto& var : _variables) {
     varFile << std::setw(16) << var->_name << " " << std::setw(16)
             << var->_procedure->_name << "  " << std::setw(5) << var->_level
-            << " " << std::setw(4) << TypeToString[var->_type] << " "
+            << " " << std::setw(4) << TypeToString(var->_type) << " "
             << std::setw(5) << var->_address << " " << std::setw(5)
             << var->_kind << "\n";
   }
@@ -468,7 +790,7 @@ auto Parser::formatPrint(std::ofstream& dysFile, std::ofstream& varFile,
       << "     ProduceName     Type  Level  FirstVarAddress  LastVarAddress\n";
   for (const auto& pro : _procedures) {
     proFile << std::setw(16) << pro->_name << "  " << std::setw(7)
-            << TypeToString[pro->_type] << "  " << std::setw(5) << pro->_level
+            << TypeToString(pro->_type) << "  " << std::setw(5) << pro->_level
             << "  " << std::setw(15) << pro->_first_var_address << "  "
             << std::setw(14) << pro->_last_val_address << "\n";
   }
@@ -1,15 +1,17 @@
 #pragma once
 #include <cstddef>
 #include <memory>
-#include <stack>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "chunked.hh"
+#include "diagnostics.hh"
 #include "lexer.hh"
 
 enum class Type { VOID, INT, STRING };
 
-extern std::unordered_map<Type, std::string> TypeToString;
+auto TypeToString(const Type& type) -> const char*;
 
 class Variable {
  public:
@@ -39,6 +41,7 @@ class Procedure {
   size_t _level;
   int _first_var_address;
   int _last_val_address;
+  std::shared_ptr<Procedure> _parent;  // 直接所在的函数, main 与导入的函数为空
 
   Procedure(const std::string& name, const Type type, const size_t level)
       : _name(std::move(name)), _type(type), _level(level) {
@@ -47,28 +50,126 @@ class Procedure {
   }
 };
 
+class ModuleInterface;
+
 class Parser {
  public:
-  Parser(const std::vector<Token>& tokens);
-  auto formatPrint(std::ofstream& dysFile, std::ofstream& varFile, std::ofstream& proFile) const -> void;
+  /* imports 中的函数在本模块找不到同名函数时使用 */
+  Parser(const TokenSequence& tokens, Diagnostics& diagnostics,
+         const std::vector<const ModuleInterface*>& imports = {});
+  auto formatPrint(std::ostream& dysFile, std::ostream& varFile, std::ostream& proFile) const -> void;
   auto good() const -> const bool { return _flag; }
+  auto getResults() const -> const TokenSequence& { return _results; }
+  auto getVariables() const
+      -> const ChunkedVector<std::shared_ptr<class Variable>>& {
+    return _variables;
+  }
+  auto getProcedures() const
+      -> const ChunkedVector<std::shared_ptr<Procedure>>& {
+    return _procedures;
+  }
+  /* 应用词法增量更新, 仅从编辑位置之前最近的主程序语句开始重新分析 */
+  auto Update(const TokenEdit& edit) -> void;
 
  private:
+  /* 检查点在 token、结果、行、错误与诊断序列中的位置 */
+  struct Position {
+    size_t token = 0;
+    size_t result = 0;
+    int line = 0;
+    int errors = 0;
+    size_t diagnostic = 0;
+
+    auto operator+=(const Position& other) -> Position& {
+      token += other.token;
+      result += other.result;
+      line += other.line;
+      errors += other.errors;
+      diagnostic += other.diagnostic;
+      return *this;
+    }
+  };
+
+  /* 主程序层每条说明/执行语句开始处的解析状态.
+   * offset 为相对前一个检查点的位移, 编辑之后的检查点无需逐个平移 */
+  struct Checkpoint {
+    bool is_execution;
+    Position offset;
+    size_t variable;
+    size_t procedure;
+    int idx;
+    int address;
+    int first_var_address;  // main 的地址范围
+    int last_val_address;
+  };
+
+  struct CheckpointOffset {
+    using Summary = Position;
+    static auto Of(const Checkpoint& checkpoint) -> Position {
+      return checkpoint.offset;
+    }
+  };
+  using Checkpoints = ChunkedVector<Checkpoint, CheckpointOffset>;
+
+  /* 增量分析时保留的旧结果, 用于在编辑区域之后重新同步.
+   * 符号与检查点从原序列上拆下, 接回时整块移交; 结果序列整个留在这里,
+   * 此时 _results 只保存重新分析的区域, 同步后替换回原位 */
+  struct Tail {
+    Checkpoint base;
+    Position base_position;
+    size_t edit_end;  // 新 token 序列中编辑区域的末尾
+    long delta;       // token 数量的变化
+    TokenSequence results;
+    ChunkedVector<std::shared_ptr<class Variable>> variables;
+    ChunkedVector<std::shared_ptr<Procedure>> procedures;
+    Checkpoints checkpoints;  // base 之后的检查点, 第一个相对 base
+    std::vector<Diagnostic> diagnostics;
+    long cursor;
+    int line;
+    int idx;
+    int address;
+    int errors;
+    int first_var_address;
+    int last_val_address;
+  };
+
+  struct Resynchronized {};
+
+  Diagnostics& _diagnostics;
+  size_t _first_diagnostic;
   bool _flag;
+  int _errors;
   int _line;
   int _idx;
   int _current_address;
-  std::vector<Token> _tokens;
-  std::vector<Token>::iterator _cursor;
-  std::vector<Token> _results;
-  std::vector<std::shared_ptr<Variable>> _variables;
-  std::vector<std::shared_ptr<Procedure>> _procedures;
-  std::stack<std::shared_ptr<Procedure>> _callStack;
-
-  auto AddError(const std::string& msg)->void;
+  TokenSequence _tokens;
+  TokenSequence::const_iterator _cursor;
+  TokenSequence _results;
+  ChunkedVector<std::shared_ptr<Variable>> _variables;
+  ChunkedVector<std::shared_ptr<Procedure>> _procedures;
+  std::vector<std::shared_ptr<Procedure>> _callStack;  // 外层函数链, 末尾为当前函数
+  /* 链上每个函数开始时 _variables 与 _procedures 的长度. 函数自己的变量和
+   * 直接说明的函数都登记在它开始之后、内一层函数开始之前 */
+  std::vector<std::pair<size_t, size_t>> _scope_starts;
+  std::vector<const ModuleInterface*> _imports;
+  std::vector<std::shared_ptr<Procedure>> _imported;  // 已解析的外部函数
+  Checkpoints _checkpoints;
+  std::unique_ptr<Tail> _tail;
+
+  auto AddError(const DiagnosticCode& code,
+                std::vector<std::string> args = {}) -> void;
   auto SkipEndOfLine() -> void;
+  auto SaveCheckpoint(bool is_execution) -> void;
+  auto TrySplice(const Position& position, const Checkpoint& checkpoint)
+      -> bool;
+  auto DropTail() -> void;
+  auto ResultCount() const -> size_t;
+  auto LastResult() const -> const Token&;
+  auto Resume(bool is_execution) -> void;
   auto Match(const TokenType& type,
-             const std::string& err_message = "") -> void;
+             const DiagnosticCode& code = DiagnosticCode::EXPECTED_TOKEN)
+      -> void;
+  auto MatchIdent() -> std::string;
   auto Program() -> void;
   auto SubProgram() -> void;
   auto Declarations() -> void;
@@ -111,6 +212,10 @@ class Parser {
   auto findDuplicateProcedure(const std::string& name) -> bool;
   auto findProcedure(const std::string& name)
       -> std::shared_ptr<class Procedure>;
+  auto findImportedProcedure(const std::string& name)
+      -> std::shared_ptr<class Procedure>;
+  auto EnterScope(const std::shared_ptr<Procedure>& procedure) -> void;
+  auto LeaveScope() -> void;
 
   auto updateProcedureVariableAddresses() -> void;
 };
\ No newline at end of file
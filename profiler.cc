@@ -0,0 +1,181 @@
+#include "profiler.hh"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+Profile::Profile(const Executable& executable, const ProfileMode& mode)
+    : _executable(executable),
+      _mode(mode),
+      _entries(executable.code.size()),
+      _exits(executable.code.size()),
+      _calls(executable.procedures.size()),
+      _current(0),
+      _last_steps(0) {
+  _nodes.push_back({0, -1, 0});
+}
+
+static auto FallsThrough(const OpCode& op) -> bool {
+  switch (op) {
+    case OpCode::JUMP:
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::CALL:
+    case OpCode::TAIL_CALL:
+    case OpCode::RETURN:
+    case OpCode::HALT:
+      return false;
+    default:
+      return true;
+  }
+}
+
+auto Profile::AddChild(int32_t node, int32_t procedure) -> int32_t {
+  const int32_t child = _nodes.size();
+  _nodes.push_back({procedure, node, _nodes[node].depth + 1});
+  _nodes[node].children.emplace_back(procedure, child);
+  return child;
+}
+
+auto Profile::Merge(const Profile& other) -> void {
+  for (size_t i = 0; i < _entries.size(); i++) {
+    _entries[i] += other._entries[i];
+    _exits[i] += other._exits[i];
+  }
+  for (size_t i = 0; i < _calls.size(); i++) {
+    _calls[i] += other._calls[i];
+  }
+  std::vector<std::pair<int32_t, int32_t>> pending = {{0, 0}};
+  while (!pending.empty()) {
+    const auto [from, to] = pending.back();
+    pending.pop_back();
+    const auto& source = other._nodes[from];
+    _nodes[to].calls += source.calls;
+    _nodes[to].steps += source.steps;
+    _nodes[to].nanoseconds += source.nanoseconds;
+    for (const auto& child : source.children) {
+      pending.emplace_back(child.second, Child(to, child.first));
+    }
+  }
+}
+
+/* 深度优先遍历, 只维护当前一条路径, 边遍历边输出 */
+auto Profile::WriteFolded(std::ostream& out) const -> void {
+  std::string path;
+  std::vector<std::pair<int32_t, size_t>> stack;  // (节点, 下一个子节点)
+  std::vector<size_t> lengths;                    // 进入节点前的路径长度
+  auto visit = [&](int32_t node) {
+    lengths.push_back(path.size());
+    if (!path.empty()) {
+      path.push_back(';');
+    }
+    path.append(_executable.procedures[_nodes[node].procedure].name);
+    const auto weight = _mode == ProfileMode::TIME ? _nodes[node].nanoseconds
+                                                   : _nodes[node].steps;
+    if (weight) {
+      out << path << " " << weight << "\n";
+    }
+    stack.emplace_back(node, 0);
+  };
+  visit(0);
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    const auto& children = _nodes[top.first].children;
+    if (top.second == children.size()) {
+      path.resize(lengths.back());
+      lengths.pop_back();
+      stack.pop_back();
+      continue;
+    }
+    visit(children[top.second++].second);
+  }
+}
+
+auto Profile::WriteJson(std::ostream& out) const -> void {
+  struct Totals {
+    uint64_t calls = 0;
+    uint64_t exclusive_steps = 0;
+    uint64_t inclusive_steps = 0;
+    uint64_t exclusive_nanoseconds = 0;
+    uint64_t inclusive_nanoseconds = 0;
+  };
+  std::vector<Totals> totals(_executable.procedures.size());
+  totals[0].calls = _nodes[0].calls;
+  for (size_t i = 1; i < totals.size(); i++) {
+    totals[i].calls = _calls[i];
+  }
+  std::vector<uint64_t> subtree_steps(_nodes.size());
+  std::vector<uint64_t> subtree_nanoseconds(_nodes.size());
+  for (size_t i = _nodes.size(); i-- > 0;) {
+    const auto& node = _nodes[i];
+    subtree_steps[i] += node.steps;
+    subtree_nanoseconds[i] += node.nanoseconds;
+    if (node.parent != -1) {
+      subtree_steps[node.parent] += subtree_steps[i];
+      subtree_nanoseconds[node.parent] += subtree_nanoseconds[i];
+    }
+    auto& total = totals[node.procedure];
+    total.exclusive_steps += node.steps;
+    total.exclusive_nanoseconds += node.nanoseconds;
+  }
+  /* 递归调用只在最外层的活动记录上计入包含时间 */
+  std::vector<size_t> active(_executable.procedures.size());
+  std::vector<std::pair<int32_t, size_t>> stack = {{0, 0}};
+  active[_nodes[0].procedure]++;
+  totals[_nodes[0].procedure].inclusive_steps += subtree_steps[0];
+  totals[_nodes[0].procedure].inclusive_nanoseconds += subtree_nanoseconds[0];
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    const auto& children = _nodes[top.first].children;
+    if (top.second == children.size()) {
+      active[_nodes[top.first].procedure]--;
+      stack.pop_back();
+      continue;
+    }
+    const auto child = children[top.second++].second;
+    const auto procedure = _nodes[child].procedure;
+    if (!active[procedure]++) {
+      totals[procedure].inclusive_steps += subtree_steps[child];
+      totals[procedure].inclusive_nanoseconds += subtree_nanoseconds[child];
+    }
+    stack.emplace_back(child, 0);
+  }
+  /* 一条指令的执行次数 = 从上一条指令顺序执行过来的次数 + 转移到这里的次数
+   * - 在这里停止的次数. 跳转、调用、返回与 HALT 之后的执行都记在转移目标上 */
+  std::map<int, uint64_t> lines;
+  const auto& code = _executable.code;
+  uint64_t executed = 0;
+  for (size_t i = 0; i < code.size(); i++) {
+    if (i > 0 && !FallsThrough(code[i - 1].op)) {
+      executed = 0;
+    }
+    executed += _entries[i];
+    executed -= _exits[i];
+    if (executed) {
+      lines[_executable.lines[i]] += executed;
+    }
+  }
+
+  out << "{\n  \"mode\": \""
+      << (_mode == ProfileMode::TIME ? "time" : "count")
+      << "\",\n  \"procedures\": [";
+  for (size_t i = 0; i < totals.size(); i++) {
+    const auto& total = totals[i];
+    out << (i ? ",\n" : "\n") << "    {\"name\": \""
+        << _executable.procedures[i].name << "\", \"calls\": " << total.calls
+        << ", \"inclusive_steps\": " << total.inclusive_steps
+        << ", \"exclusive_steps\": " << total.exclusive_steps;
+    if (_mode == ProfileMode::TIME) {
+      out << ", \"inclusive_ns\": " << total.inclusive_nanoseconds
+          << ", \"exclusive_ns\": " << total.exclusive_nanoseconds;
+    }
+    out << "}";
+  }
+  out << "\n  ],\n  \"lines\": [";
+  auto first = true;
+  for (const auto& line : lines) {
+    out << (first ? "\n" : ",\n") << "    {\"line\": " << line.first
+        << ", \"steps\": " << line.second << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "codegen.hh"
+
+/* COUNT 在调用和返回时统计调用次数与指令数, 并在每次控制转移时给目标基本块
+ * 计数, 输出时沿顺序执行的指令推出每条指令的执行次数并按行累加;
+ * TIME 额外在调用和返回时读时钟 */
+enum class ProfileMode { OFF, COUNT, TIME };
+
+/* 调用树的最大深度, 更深的调用并入该深度的节点 */
+const int32_t MAX_PROFILE_DEPTH = 256;
+
+/* 调用树上的一个节点, 对应一条从 main 开始的调用路径.
+ * 直接递归与超过最大深度的调用不新建节点, 只在 folded 计数上记下 */
+struct ProfileNode {
+  int32_t procedure;
+  int32_t parent;
+  int32_t depth;
+  uint32_t folded = 0;  // 当前并入该节点、尚未返回的活动记录数
+  uint64_t calls = 0;
+  uint64_t steps = 0;        // 在该路径上自身执行的指令数
+  uint64_t nanoseconds = 0;  // 在该路径上自身花费的时间
+  std::vector<std::pair<int32_t, int32_t>> children;  // (函数, 节点)
+};
+
+/* 执行剖析数据. 每个工作线程各有一份, 结束后合并 */
+class Profile {
+ public:
+  Profile(const Executable& executable, const ProfileMode& mode);
+  auto getMode() const -> const ProfileMode& { return _mode; }
+
+  /* 以下由虚拟机在执行路径上调用 */
+  auto Begin(int32_t entry, uint64_t steps) -> void {
+    _entries[entry]++;
+    _current = 0;
+    _last_steps = steps;
+    if (_mode == ProfileMode::TIME) {
+      _last_time = std::chrono::steady_clock::now();
+    }
+    _nodes[0].calls++;
+  }
+  /* 跳转、条件跳转不成立时的下一条指令、调用命中缓存或返回后的下一条指令 */
+  auto Branch(int32_t target) -> void { _entries[target]++; }
+  auto Enter(int32_t procedure, uint64_t steps) -> void {
+    Charge(steps);
+    _calls[procedure]++;
+    _entries[_executable.procedures[procedure].entry]++;
+    auto& node = _nodes[_current];
+    if (node.procedure == procedure || node.depth == MAX_PROFILE_DEPTH) {
+      node.folded++;
+      node.calls++;
+      return;
+    }
+    _current = Child(_current, procedure);
+    _nodes[_current].calls++;
+  }
+  auto Leave(uint64_t steps) -> void {
+    Charge(steps);
+    auto& node = _nodes[_current];
+    if (node.folded) {
+      node.folded--;
+      return;
+    }
+    _current = node.parent;
+  }
+  /* next 为本应顺序执行却因作业停止而没有执行的指令, 没有时为 -1 */
+  auto Finish(uint64_t steps, int32_t next) -> void {
+    Charge(steps);
+    if (next >= 0 && size_t(next) < _exits.size()) {
+      _exits[next]++;
+    }
+    /* 作业可能停在调用中途, 清掉路径上残留的计数 */
+    for (auto node = _current; node != -1; node = _nodes[node].parent) {
+      _nodes[node].folded = 0;
+    }
+    _current = 0;
+  }
+
+  auto Merge(const Profile& other) -> void;
+  /* 火焰图工具使用的折叠栈格式: "main;F;F 权重" */
+  auto WriteFolded(std::ostream& out) const -> void;
+  auto WriteJson(std::ostream& out) const -> void;
+
+ private:
+  const Executable& _executable;
+  ProfileMode _mode;
+  std::vector<ProfileNode> _nodes;
+  std::vector<uint64_t> _entries;  // 每条指令作为控制转移目标的次数
+  std::vector<uint64_t> _exits;    // 顺序执行到该指令之前作业停止的次数
+  std::vector<uint64_t> _calls;    // 每个函数的调用次数, 不受节点合并影响
+  int32_t _current;
+  uint64_t _last_steps;
+  std::chrono::steady_clock::time_point _last_time;
+
+  auto Child(int32_t node, int32_t procedure) -> int32_t {
+    for (const auto& child : _nodes[node].children) {
+      if (child.first == procedure) {
+        return child.second;
+      }
+    }
+    return AddChild(node, procedure);
+  }
+  auto AddChild(int32_t node, int32_t procedure) -> int32_t;
+  /* 把上次记录以来的指令数和时间记到当前节点 */
+  auto Charge(uint64_t steps) -> void {
+    _nodes[_current].steps += steps - _last_steps;
+    _last_steps = steps;
+    if (_mode == ProfileMode::TIME) {
+      const auto now = std::chrono::steady_clock::now();
+      _nodes[_current].nanoseconds +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - _last_time)
+              .count();
+      _last_time = now;
+    }
+  }
+};
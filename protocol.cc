@@ -0,0 +1,58 @@
+#include "protocol.hh"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+
+auto ReadAll(int fd, void* data, size_t size) -> bool {
+  auto cursor = static_cast<char*>(data);
+  while (size > 0) {
+    const auto n = ::read(fd, cursor, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    cursor += n;
+    size -= n;
+  }
+  return true;
+}
+
+auto WriteAll(int fd, const void* data, size_t size) -> bool {
+  auto cursor = static_cast<const char*>(data);
+  while (size > 0) {
+    const auto n = ::write(fd, cursor, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    cursor += n;
+    size -= n;
+  }
+  return true;
+}
+
+auto ReadFrame(int fd, std::string& frame, size_t limit) -> bool {
+  uint32_t size;
+  if (!ReadAll(fd, &size, sizeof(size))) {
+    return false;
+  }
+  if (size > limit) {
+    errno = EMSGSIZE;
+    return false;
+  }
+  frame.resize(size);
+  return ReadAll(fd, frame.data(), size);
+}
+
+auto WriteFrame(int fd, const std::string& frame) -> bool {
+  const auto size = uint32_t(frame.size());
+  return WriteAll(fd, &size, sizeof(size)) &&
+         WriteAll(fd, frame.data(), frame.size());
+}
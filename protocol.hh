@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* 编译服务器默认监听的 Unix 域套接字 */
+const std::string DEFAULT_SOCKET_PATH = "/tmp/uestc_compiler.sock";
+
+/* 请求: 1 字节命令 + 一帧源码; 响应: 1 字节状态 + 若干帧 */
+enum class Command : uint8_t { COMPILE = 'C', STATS = 'S' };
+enum class Status : uint8_t { OK, LEXER_ERROR, PARSER_ERROR, FRAME_TOO_LARGE };
+
+/* 请求帧的长度上限, 避免按对端声明的长度分配任意大的内存 */
+const uint32_t MAX_FRAME_SIZE = 64u << 20;
+
+/* 每帧为 4 字节长度加内容, 连接断开或出错时返回 false.
+ * ReadFrame 遇到超过 limit 的帧时不读取内容, 置 errno 为 EMSGSIZE */
+auto ReadAll(int fd, void* data, size_t size) -> bool;
+auto WriteAll(int fd, const void* data, size_t size) -> bool;
+auto ReadFrame(int fd, std::string& frame, size_t limit = MAX_FRAME_SIZE)
+    -> bool;
+auto WriteFrame(int fd, const std::string& frame) -> bool;
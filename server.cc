@@ -0,0 +1,383 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "diagnostics.hh"
+#include "lexer.hh"
+#include "parser.hh"
+#include "protocol.hh"
+
+/* 结果缓存中源码与响应的总字节数上限, 超过后整体清空 */
+const size_t CACHE_CAPACITY = 256u << 20;
+/* 超过该大小的源码不缓存, 以免单个请求占满缓存 */
+const size_t CACHE_MAX_SOURCE = 1u << 20;
+
+static volatile std::sig_atomic_t running = 1;
+
+static auto Stop(int) -> void { running = 0; }
+
+static auto AppendFrame(std::string& response, const std::string& frame)
+    -> void {
+  const auto size = uint32_t(frame.size());
+  response.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  response.append(frame);
+}
+
+/* 编译一份源码, 返回序列化好的响应: 状态 + err/dyd/dys/var/pro 五帧 */
+static auto Compile(const std::string& source) -> std::string {
+  std::ostringstream err, dyd, dys, var, pro;
+  auto status = Status::OK;
+  Diagnostics diagnostics;
+  Lexer lexer(SplitWords(source), diagnostics);
+  if (!lexer.good()) {
+    status = Status::LEXER_ERROR;
+  } else {
+    lexer.formatPrint(dyd);
+    Parser parser(lexer.getTokens(), diagnostics);
+    if (!parser.good()) {
+      status = Status::PARSER_ERROR;
+    }
+    parser.formatPrint(dys, var, pro);
+  }
+  diagnostics.Emit(err, DiagnosticFormat::TEXT);
+
+  std::string response(1, char(status));
+  for (const auto* stream : {&err, &dyd, &dys, &var, &pro}) {
+    AppendFrame(response, stream->str());
+  }
+  return response;
+}
+
+/* 空闲连接超过该时间没有新请求时关闭 */
+const auto IDLE_TIMEOUT = std::chrono::seconds(30);
+/* 读写一个请求的超时, 防止发了一半就停下的客户端一直占住工作线程 */
+const time_t REQUEST_TIMEOUT_SECONDS = 10;
+/* 统计延迟分位数时只保留最近的这么多个请求 */
+const size_t LATENCY_WINDOW = 4096;
+
+/* 主线程用 poll 等待监听套接字与所有空闲连接, 某个连接上有请求到达时
+ * 才交给工作线程处理这一个请求, 处理完放回空闲集合.
+ * 连接数因此不受线程数限制, 空闲的连接也不占用线程 */
+class CompileServer {
+ public:
+  CompileServer(int listener, size_t threads)
+      : _listener(listener), _latencies(LATENCY_WINDOW) {
+    if (::pipe(_wake) < 0) {
+      throw std::runtime_error("Failed to create wake-up pipe");
+    }
+    for (const auto fd : _wake) {
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    for (size_t i = 0; i < threads; i++) {
+      _workers.emplace_back([this] { Work(); });
+    }
+  }
+
+  ~CompileServer() {
+    {
+      std::lock_guard<std::mutex> lock(_queue_mutex);
+      _stopping = true;
+      /* 正在处理的请求可能阻塞在读写上, 关闭连接让工作线程返回 */
+      for (const auto fd : _active) {
+        ::shutdown(fd, SHUT_RDWR);
+      }
+    }
+    _queue_ready.notify_all();
+    for (auto& worker : _workers) {
+      worker.join();
+    }
+    for (; !_requests.empty(); _requests.pop()) {
+      ::close(_requests.front());
+    }
+    for (const auto fd : _returned) {
+      ::close(fd);
+    }
+    for (const auto& [fd, since] : _idle) {
+      ::close(fd);
+    }
+    ::close(_wake[0]);
+    ::close(_wake[1]);
+  }
+
+  /* 接受连接并分发请求, 直到收到停止信号 */
+  auto Run() -> void {
+    std::vector<pollfd> polls;
+    while (running) {
+      polls.clear();
+      polls.push_back({_listener, POLLIN, 0});
+      polls.push_back({_wake[0], POLLIN, 0});
+      for (const auto& [fd, since] : _idle) {
+        polls.push_back({fd, POLLIN, 0});
+      }
+      if (::poll(polls.data(), polls.size(), 200) < 0) {
+        continue;
+      }
+      const auto now = std::chrono::steady_clock::now();
+      for (auto it = polls.begin() + 2; it != polls.end(); it++) {
+        if (it->revents) {
+          _idle.erase(it->fd);
+          Submit(it->fd);
+        }
+      }
+      for (auto it = _idle.begin(); it != _idle.end();) {
+        if (now - it->second > IDLE_TIMEOUT) {
+          ::close(it->first);
+          it = _idle.erase(it);
+        } else {
+          it++;
+        }
+      }
+      if (polls[1].revents & POLLIN) {
+        char buffer[64];
+        while (::read(_wake[0], buffer, sizeof(buffer)) > 0) {
+        }
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+        for (const auto fd : _returned) {
+          _idle[fd] = now;
+        }
+        _returned.clear();
+      }
+      if (polls[0].revents & POLLIN) {
+        const int fd = ::accept(_listener, nullptr, nullptr);
+        if (fd >= 0) {
+          const timeval timeout{REQUEST_TIMEOUT_SECONDS, 0};
+          ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+          ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+          _idle[fd] = now;
+        }
+      }
+    }
+  }
+
+  auto Stats() -> std::string {
+    std::vector<int64_t> latencies;
+    size_t requests, hits;
+    {
+      std::lock_guard<std::mutex> lock(_stats_mutex);
+      requests = _request_count;
+      latencies.assign(_latencies.begin(),
+                       _latencies.begin() + std::min(requests, LATENCY_WINDOW));
+      hits = _cache_hits;
+    }
+    std::ostringstream out;
+    out << "requests: " << requests << ", cache hits: " << hits;
+    if (!latencies.empty()) {
+      out << ", p50: " << Percentile(latencies, 50)
+          << " us, p99: " << Percentile(latencies, 99) << " us";
+    }
+    out << "\n";
+    return out.str();
+  }
+
+ private:
+  int _listener;
+  int _wake[2];  // 工作线程交还连接时写入, 唤醒主线程的 poll
+  std::unordered_map<int, std::chrono::steady_clock::time_point>
+      _idle;  // 空闲连接及其最近一次活动时间, 只由主线程访问
+
+  std::vector<std::thread> _workers;
+  std::mutex _queue_mutex;
+  std::condition_variable _queue_ready;
+  std::queue<int> _requests;           // 有请求到达、等待处理的连接
+  std::unordered_set<int> _active;     // 正在处理请求的连接
+  std::vector<int> _returned;          // 处理完、等待放回空闲集合的连接
+  bool _stopping = false;
+
+  std::mutex _cache_mutex;
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> _cache;
+  size_t _cache_bytes = 0;  // 缓存中键与响应的总字节数
+
+  std::mutex _stats_mutex;
+  std::vector<int64_t> _latencies;  // 最近请求的处理时间 (微秒), 环形缓冲
+  size_t _request_count = 0;
+  size_t _cache_hits = 0;
+
+  static auto Percentile(std::vector<int64_t>& values, size_t percent)
+      -> int64_t {
+    auto nth = values.begin() + (values.size() - 1) * percent / 100;
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+  }
+
+  auto Submit(int fd) -> void {
+    {
+      std::lock_guard<std::mutex> lock(_queue_mutex);
+      _requests.push(fd);
+    }
+    _queue_ready.notify_one();
+  }
+
+  auto Work() -> void {
+    while (true) {
+      int fd;
+      {
+        std::unique_lock<std::mutex> lock(_queue_mutex);
+        _queue_ready.wait(lock,
+                          [this] { return _stopping || !_requests.empty(); });
+        if (_stopping) {
+          return;
+        }
+        fd = _requests.front();
+        _requests.pop();
+        _active.insert(fd);
+      }
+      const auto keep = Serve(fd);
+      {
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+        _active.erase(fd);
+        if (keep && !_stopping) {
+          _returned.push_back(fd);
+          fd = -1;
+        }
+      }
+      if (fd >= 0) {
+        ::close(fd);
+        continue;
+      }
+      const char wake = 0;
+      ::write(_wake[1], &wake, sizeof(wake));
+    }
+  }
+
+  /* 处理连接上的一个请求, 返回连接是否还能继续使用 */
+  auto Serve(int fd) -> bool {
+    Command command;
+    if (!ReadAll(fd, &command, sizeof(command))) {
+      return false;
+    }
+    if (command == Command::STATS) {
+      std::string response(1, char(Status::OK));
+      AppendFrame(response, Stats());
+      return WriteAll(fd, response.data(), response.size());
+    }
+    std::string source;
+    if (command != Command::COMPILE) {
+      return false;
+    }
+    if (!ReadFrame(fd, source)) {
+      if (errno == EMSGSIZE) {
+        std::string response(1, char(Status::FRAME_TOO_LARGE));
+        AppendFrame(response, "Source exceeds " +
+                                  std::to_string(MAX_FRAME_SIZE) + " bytes\n");
+        for (int i = 0; i < 4; i++) {
+          AppendFrame(response, "");
+        }
+        WriteAll(fd, response.data(), response.size());
+      }
+      return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto response = Lookup(source);
+    if (!WriteAll(fd, response->data(), response->size())) {
+      return false;
+    }
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    _latencies[_request_count % LATENCY_WINDOW] = latency.count();
+    _request_count++;
+    return true;
+  }
+
+  auto Lookup(const std::string& source) -> std::shared_ptr<const std::string> {
+    {
+      std::lock_guard<std::mutex> lock(_cache_mutex);
+      const auto it = _cache.find(source);
+      if (it != _cache.end()) {
+        std::lock_guard<std::mutex> stats_lock(_stats_mutex);
+        _cache_hits++;
+        return it->second;
+      }
+    }
+    auto response = std::make_shared<const std::string>(Compile(source));
+    const auto bytes = source.size() + response->size();
+    if (source.size() > CACHE_MAX_SOURCE || bytes > CACHE_CAPACITY) {
+      return response;
+    }
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+    if (_cache_bytes + bytes > CACHE_CAPACITY) {
+      _cache.clear();
+      _cache_bytes = 0;
+    }
+    if (_cache.emplace(source, response).second) {
+      _cache_bytes += bytes;
+    }
+    return response;
+  }
+};
+
+int main(int argc, char* argv[]) {
+  const std::string socket_path = argc > 1 ? argv[1] : DEFAULT_SOCKET_PATH;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 2) {
+    const std::string_view text = argv[2];
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), threads);
+    if (error != std::errc() || end != text.data() + text.size() ||
+        threads == 0) {
+      std::cerr << "Invalid thread count: " << text
+                << " (expected a positive integer)" << std::endl;
+      return 1;
+    }
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Socket path too long: " << socket_path << std::endl;
+    return 1;
+  }
+  socket_path.copy(address.sun_path, socket_path.size());
+
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(socket_path.c_str());
+  if (listener < 0 ||
+      ::bind(listener, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) < 0 ||
+      ::listen(listener, SOMAXCONN) < 0) {
+    std::perror("Failed to listen on socket");
+    return 1;
+  }
+
+  std::signal(SIGINT, Stop);
+  std::signal(SIGTERM, Stop);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::cout << "Listening on " << socket_path << " with " << threads
+            << " threads" << std::endl;
+
+  std::string stats;
+  {
+    CompileServer server(listener, threads);
+    server.Run();
+    stats = server.Stats();
+  }
+  ::close(listener);
+  ::unlink(socket_path.c_str());
+  std::cout << stats;
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench/generator.hh"
+#include "diagnostics.hh"
+#include "incremental.hh"
+#include "lexer.hh"
+#include "parser.hh"
+
+/* 一次分析的全部输出, 增量结果必须与从头分析完全相同 */
+struct Snapshot {
+  std::string tokens;       // 词法分析结果 (.dyd)
+  std::string results;      // 语法分析结果 (.dys)
+  std::string variables;    // 变量表 (.var)
+  std::string procedures;   // 过程表 (.pro)
+  std::string diagnostics;  // 词法与语法诊断
+  bool good;
+};
+
+static auto Capture(const Lexer& lexer, const Parser& parser,
+                    const Diagnostics& lexer_diagnostics,
+                    const Diagnostics& parser_diagnostics) -> Snapshot {
+  std::ostringstream tokens, results, variables, procedures, diagnostics;
+  lexer.formatPrint(tokens);
+  parser.formatPrint(results, variables, procedures);
+  lexer_diagnostics.Emit(diagnostics, DiagnosticFormat::TEXT);
+  parser_diagnostics.Emit(diagnostics, DiagnosticFormat::TEXT);
+  return {tokens.str(),    results.str(),     variables.str(),
+          procedures.str(), diagnostics.str(), lexer.good() && parser.good()};
+}
+
+static auto Fresh(const std::string& source) -> Snapshot {
+  Diagnostics lexer_diagnostics, parser_diagnostics;
+  Lexer lexer(SplitWords(source), lexer_diagnostics);
+  Parser parser(lexer.getTokens(), parser_diagnostics);
+  return Capture(lexer, parser, lexer_diagnostics, parser_diagnostics);
+}
+
+/* 返回第一处不同的部分, 全部相同时返回空串 */
+static auto Compare(const Snapshot& got, const Snapshot& expected)
+    -> std::string {
+  if (got.tokens != expected.tokens) return "tokens";
+  if (got.results != expected.results) return "parser results";
+  if (got.variables != expected.variables) return "variable table";
+  if (got.procedures != expected.procedures) return "procedure table";
+  if (got.diagnostics != expected.diagnostics) return "diagnostics";
+  if (got.good != expected.good) return "good()";
+  return "";
+}
+
+/* 插入的片段偏向容易破坏增量状态的情形: 换行, 跨行注释与字符串, 函数与语句 */
+static const char* const PIECES[] = {
+    "k",  ";",   "\n",        "x",     " ",           "integer j;\n",
+    "write(v1);\n",           "{c}",   "(*\n*)",      "'s'",
+    "f8(1)",     ":=",        "1",     "end",         "begin",
+    "v1:=v1-1;\n",            "a",     "{",           "}",
+    "(*", "*)",  "'",         "'{'",   " { note }",   "{\n",
+    "\n}",       "(*x\ny*)",  "99999999999999999999",  "$",
+    "integer function g(q);\nbegin\ninteger q;\ng:=q\nend;\n"};
+
+/* 对 source 随机编辑 edits 次, 每次编辑后与从头分析比较 */
+static auto Run(const std::string& name, std::string source, uint64_t seed,
+                size_t edits) -> bool {
+  std::mt19937_64 rng(seed);
+  IncrementalCompiler compiler(source);
+  for (size_t edit = 0; edit < edits; edit++) {
+    const size_t offset = rng() % (source.size() + 1);
+    const size_t removed = std::min<size_t>(rng() % 6, source.size() - offset);
+    const std::string inserted =
+        rng() % 3 == 0 ? "" : PIECES[rng() % std::size(PIECES)];
+    compiler.Edit(offset, removed, inserted);
+    source.replace(offset, removed, inserted);
+
+    std::string mismatch;
+    if (compiler.getSource() != source) {
+      mismatch = "source";
+    } else {
+      mismatch = Compare(
+          Capture(compiler.getLexer(), compiler.getParser(),
+                  compiler.getLexerDiagnostics(),
+                  compiler.getParserDiagnostics()),
+          Fresh(source));
+    }
+    if (!mismatch.empty()) {
+      std::cerr << name << ": " << mismatch << " differ after edit " << edit
+                << " (seed " << seed << ", offset " << offset << ", removed "
+                << removed << ", inserted '" << inserted << "')" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static auto Usage(const char* name) -> int {
+  std::cerr << "Usage: " << name << " [--seed=N] [--edits=N] [SOURCE...]\n"
+               "Without SOURCE, uses the programs in Test/ and a few "
+               "generated ones."
+            << std::endl;
+  return 1;
+}
+
+/* 整个字符串都是非负整数时才成功 */
+template <typename T>
+static auto ParseNumber(const std::string& text, T& value) -> bool {
+  const auto end = text.data() + text.size();
+  const auto [next, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && next == end && !text.empty();
+}
+
+int main(int argc, char* argv[]) {
+  uint64_t seed = 1;
+  size_t edits = 1000;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg.rfind("--seed=", 0) == 0) {
+      if (!ParseNumber(arg.substr(std::string("--seed=").size()), seed)) {
+        return Usage(argv[0]);
+      }
+    } else if (arg.rfind("--edits=", 0) == 0) {
+      if (!ParseNumber(arg.substr(std::string("--edits=").size()), edits)) {
+        return Usage(argv[0]);
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage(argv[0]);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> sources;
+  if (paths.empty()) {
+    paths = {"Test/source.pas", "Test/scopes.pas", "Test/error.pas"};
+    /* 生成的程序带有嵌套函数与可恢复的语法错误 */
+    for (const double error_rate : {0.0, 0.2}) {
+      GeneratorOptions options;
+      options.size = 8 << 10;
+      options.functions = 4;
+      options.error_rate = error_rate;
+      options.seed = seed;
+      std::ostringstream out;
+      GenerateProgram(options, out);
+      sources.emplace_back(
+          error_rate ? "generated program with errors" : "generated program",
+          out.str());
+    }
+  }
+  for (const auto& path : paths) {
+    std::ifstream in(path);
+    if (!in) {
+      std::cerr << "Cannot open " << path << std::endl;
+      return 1;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    sources.emplace_back(path, text.str());
+  }
+
+  bool good = true;
+  for (const auto& [name, source] : sources) {
+    good = Run(name, source, seed, edits) && good;
+  }
+  std::cout << (good ? "incremental: all edits match a fresh compile"
+                     : "incremental: FAILED")
+            << std::endl;
+  return good ? 0 : 1;
+}